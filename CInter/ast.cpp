@@ -0,0 +1,61 @@
+#include "ast.h"
+
+namespace {
+
+thread_local std::vector<std::unique_ptr<Statement>> releasedNodes;
+thread_local std::vector<std::shared_ptr<Expression>> releasedSharedNodes;
+thread_local bool releasing = false;
+
+void drainReleasedNodes() noexcept
+{
+    releasing = true;
+
+    while (!releasedNodes.empty() || !releasedSharedNodes.empty()) {
+        if (!releasedNodes.empty()) {
+            auto node = std::move(releasedNodes.back());
+            releasedNodes.pop_back();
+        }
+        else {
+            auto node = std::move(releasedSharedNodes.back());
+            releasedSharedNodes.pop_back();
+        }
+    }
+
+    releasing = false;
+}
+
+}
+
+void releaseNode(std::unique_ptr<Statement> node) noexcept
+{
+    if (!node)
+        return;
+
+    try {
+        releasedNodes.push_back(std::move(node));
+    }
+    catch (...) {
+        node.reset();
+        return;
+    }
+
+    if (!releasing)
+        drainReleasedNodes();
+}
+
+void releaseSharedNode(std::shared_ptr<Expression> node) noexcept
+{
+    if (!node)
+        return;
+
+    try {
+        releasedSharedNodes.push_back(std::move(node));
+    }
+    catch (...) {
+        node.reset();
+        return;
+    }
+
+    if (!releasing)
+        drainReleasedNodes();
+}
@@ -4,6 +4,11 @@
 #include <string_view>
 #include <vector>
 #include <memory>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+struct StringValue;
 
 enum class NodeType {
     Program,
@@ -15,7 +20,9 @@ enum class NodeType {
     ObjectLiteral,
     Property,
     MemberExpression,
-    CallExpression
+    CallExpression,
+    ImportDeclaration,
+    StringLiteral
 };
 
 struct Statement {
@@ -28,6 +35,11 @@ struct Expression : public Statement {
    
 };
 
+// Destroying a node hands its children to a work list drained by the outermost release,
+// so tearing down a deeply nested tree never recurses through the node destructors.
+void releaseNode(std::unique_ptr<Statement> node) noexcept;
+void releaseSharedNode(std::shared_ptr<Expression> node) noexcept;
+
 struct Program : public Statement {
     std::vector<std::unique_ptr<Statement>> body;
 
@@ -41,7 +53,10 @@ struct Program : public Statement {
     Program(Program&&) = default;                  
     Program& operator = (Program&&) = default;      
 
-    ~Program() noexcept override = default;
+    ~Program() noexcept override {
+        for (auto& statement : body)
+            releaseNode(std::move(statement));
+    }
 };
 
 struct _Identifier : public Expression {
@@ -53,13 +68,22 @@ struct _Identifier : public Expression {
 };
 
 struct NumericLiteral : public Expression {
-    int value { NULL }; 
+    double value { 0.0 };
 
     NumericLiteral() {
         kind = NodeType::NumericLiteral;
     }
 };
 
+// The value is interned when the literal is parsed, so evaluating it never allocates.
+struct StringLiteral : public Expression {
+    std::shared_ptr<StringValue> value;
+
+    StringLiteral() {
+        kind = NodeType::StringLiteral;
+    }
+};
+
 struct VariableDeclaration : public Statement {
     bool constant { false };
     std::string identifier;
@@ -68,6 +92,22 @@ struct VariableDeclaration : public Statement {
     VariableDeclaration() {
         kind = NodeType::VariableDeclaration;
     }
+
+    ~VariableDeclaration() noexcept override {
+        releaseNode(std::move(value));
+    }
+};
+
+// `import a.b;` binds the exports of module a/b as the constant `b`.
+struct ImportDeclaration : public Statement {
+    std::vector<std::string> path;
+
+    // The name the module is bound to: the alias after `as`, otherwise the last segment of `path`.
+    std::string binding;
+
+    ImportDeclaration() {
+        kind = NodeType::ImportDeclaration;
+    }
 };
 
 struct AssignmentExpression : public Expression {
@@ -77,25 +117,47 @@ struct AssignmentExpression : public Expression {
     AssignmentExpression() {
         kind = NodeType::AssignmentExpression;
     }
+
+    ~AssignmentExpression() noexcept override {
+        releaseNode(std::move(assignee));
+        releaseNode(std::move(value));
+    }
 };
 
+struct CompiledExpression;
+
 struct BinaryExpression : public Expression {
     std::shared_ptr<Expression> left;
     std::shared_ptr<Expression> right;
     std::string _operator;
 
+    // Hotness counter and native code cache used by the JIT (see jit.h).
+    mutable std::atomic<std::uint32_t> evaluations { 0 };
+    mutable std::once_flag compileOnce;
+    mutable std::shared_ptr<CompiledExpression> compiled;
+
     BinaryExpression() {
         kind = NodeType::BinaryExpression;
     }
+
+    ~BinaryExpression() noexcept override {
+        releaseSharedNode(std::move(left));
+        releaseSharedNode(std::move(right));
+    }
 };
 
 struct Property : public Expression {
     std::string key;
+    std::shared_ptr<StringValue> internedKey;
     std::unique_ptr<Expression> value;
 
     Property() {
         kind = NodeType::Property;
     }
+
+    ~Property() noexcept override {
+        releaseNode(std::move(value));
+    }
 };
 
 struct ObjectLiteral : public Expression {
@@ -104,17 +166,30 @@ struct ObjectLiteral : public Expression {
     ObjectLiteral() {
         kind = NodeType::ObjectLiteral;
     }
+
+    ~ObjectLiteral() noexcept override {
+        for (auto& property : properties)
+            releaseNode(std::move(property));
+    }
 };
 
 struct MemberExpression : public Expression {
     std::unique_ptr<Expression> object;
     std::unique_ptr<Expression> property;
 
+    // Interned name of a non-computed property, carrying its precomputed hash.
+    std::shared_ptr<StringValue> internedKey;
+
     bool computed;
 
-    MemberExpression(bool comp) {
+    MemberExpression(bool comp = false) : computed(comp) {
         kind = NodeType::MemberExpression;
     }
+
+    ~MemberExpression() noexcept override {
+        releaseNode(std::move(object));
+        releaseNode(std::move(property));
+    }
 };
 
 struct CallExpression : public Expression {
@@ -124,4 +199,11 @@ struct CallExpression : public Expression {
     CallExpression() {
         kind = NodeType::CallExpression;
     }
+
+    ~CallExpression() noexcept override {
+        releaseNode(std::move(caller));
+
+        for (auto& arg : args)
+            releaseNode(std::move(arg));
+    }
 };
\ No newline at end of file
@@ -0,0 +1,167 @@
+#include "async.h"
+#include "event_loop.h"
+#include "natives.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+std::coroutine_handle<> NativeTask::FinalAwaiter::await_suspend(Handle handle) noexcept
+{
+	promise_type& promise = handle.promise();
+
+	if (promise.continuation)
+		return promise.continuation;
+
+	// The completion may destroy the task, and with it this frame, so nothing is touched afterwards.
+	if (promise.completion) {
+		auto completion = std::move(promise.completion);
+		completion();
+	}
+
+	return std::noop_coroutine();
+}
+
+std::coroutine_handle<> NativeTask::Awaiter::await_suspend(std::coroutine_handle<> awaiting) noexcept
+{
+	this->handle.promise().continuation = awaiting;
+	return this->handle;
+}
+
+std::shared_ptr<RuntimeValue> NativeTask::Awaiter::await_resume()
+{
+	promise_type& promise = this->handle.promise();
+
+	if (promise.error)
+		std::rethrow_exception(promise.error);
+
+	return promise.value ? promise.value : MAKE_NULL();
+}
+
+NativeTask::NativeTask(NativeTask&& other) noexcept
+	: handle(other.handle)
+{
+	other.handle = nullptr;
+}
+
+NativeTask& NativeTask::operator = (NativeTask&& other) noexcept
+{
+	if (this != &other) {
+		if (this->handle)
+			this->handle.destroy();
+
+		this->handle = other.handle;
+		other.handle = nullptr;
+	}
+
+	return *this;
+}
+
+NativeTask::~NativeTask()
+{
+	if (this->handle)
+		this->handle.destroy();
+}
+
+bool NativeTask::valid() const
+{
+	return static_cast<bool>(this->handle);
+}
+
+bool NativeTask::done() const
+{
+	return this->handle && this->handle.done();
+}
+
+void NativeTask::start(std::function<void()> completion)
+{
+	if (!this->handle)
+		throw std::logic_error("Cannot start an empty native task.");
+
+	this->handle.promise().completion = std::move(completion);
+	this->handle.resume();
+}
+
+std::shared_ptr<RuntimeValue> NativeTask::result()
+{
+	if (!this->done())
+		throw std::logic_error("Cannot read the result of an unfinished native task.");
+
+	return Awaiter{ this->handle }.await_resume();
+}
+
+std::unique_ptr<AsyncNativeFunctionValue> MAKE_ASYNC_NATIVE_FUNCTION(AsyncFunctionCall call)
+{
+	return std::make_unique<AsyncNativeFunctionValue>(std::move(call));
+}
+
+static EventLoop& expectEventLoop()
+{
+	if (!currentEventLoop)
+		throw std::runtime_error("Async natives can only suspend while an event loop is running.");
+
+	return *currentEventLoop;
+}
+
+void SleepAwaiter::await_suspend(std::coroutine_handle<> handle) const
+{
+	expectEventLoop().callAfter(this->delay, [handle] { handle.resume(); });
+}
+
+void IoAwaiter::await_suspend(std::coroutine_handle<> handle) const
+{
+	expectEventLoop().watch(this->fd, this->event, [handle] { handle.resume(); });
+}
+
+SleepAwaiter sleepFor(std::chrono::steady_clock::duration delay)
+{
+	return SleepAwaiter{ delay };
+}
+
+IoAwaiter waitReadable(int fd)
+{
+	return IoAwaiter{ fd, IoEvent::Readable };
+}
+
+IoAwaiter waitWritable(int fd)
+{
+	return IoAwaiter{ fd, IoEvent::Writable };
+}
+
+std::shared_ptr<RuntimeValue> runNativeTask(NativeTask task)
+{
+	EventLoop loop;
+
+	loop.retain();
+	loop.post([&loop, &task] {
+		task.start([&loop] {
+			loop.post([&loop] { loop.release(); });
+		});
+	});
+
+	loop.run();
+
+	return task.result();
+}
+
+static NativeTask sleepNative(std::vector<std::shared_ptr<RuntimeValue>> args, Environment&)
+{
+	double milliseconds = !args.empty() && args[0]->getType() == ValueType::Number
+		? static_cast<const NumberValue&>(*args[0]).value
+		: 0.0;
+
+	// Also rejects NaN; the upper bound keeps the conversion to clock ticks from overflowing.
+	if (!(milliseconds > 0.0))
+		milliseconds = 0.0;
+
+	milliseconds = std::min(milliseconds, 1e12);
+
+	co_await sleepFor(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+		std::chrono::duration<double, std::milli>(milliseconds)));
+
+	co_return MAKE_NULL();
+}
+
+void declareAsyncBuiltins(Environment& env)
+{
+	env.declareVariable("sleep", NativeRegistry::shared().add("sleep", MAKE_ASYNC_NATIVE_FUNCTION(sleepNative)), true);
+}
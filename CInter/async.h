@@ -0,0 +1,119 @@
+#pragma once
+
+#include "values.h"
+
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// The coroutine an async native returns. It starts suspended, produces one runtime value and may
+// co_await sleepFor, waitReadable/waitWritable or other NativeTasks in between.
+class NativeTask {
+	public:
+		struct promise_type;
+		using Handle = std::coroutine_handle<promise_type>;
+
+		struct FinalAwaiter {
+			bool await_ready() const noexcept { return false; }
+			std::coroutine_handle<> await_suspend(Handle handle) noexcept;
+			void await_resume() const noexcept {}
+		};
+
+		struct promise_type {
+			std::shared_ptr<RuntimeValue> value;
+			std::exception_ptr error;
+			std::coroutine_handle<> continuation;
+			std::function<void()> completion;
+
+			NativeTask get_return_object() { return NativeTask(Handle::from_promise(*this)); }
+			std::suspend_always initial_suspend() const noexcept { return {}; }
+			FinalAwaiter final_suspend() const noexcept { return {}; }
+			void return_value(std::shared_ptr<RuntimeValue> result) { value = std::move(result); }
+			void unhandled_exception() { error = std::current_exception(); }
+		};
+
+		struct Awaiter {
+			Handle handle;
+
+			bool await_ready() const noexcept { return handle.done(); }
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept;
+			std::shared_ptr<RuntimeValue> await_resume();
+		};
+
+	private:
+		Handle handle;
+
+	public:
+		NativeTask() = default;
+		explicit NativeTask(Handle handle) : handle(handle) {}
+		NativeTask(NativeTask&& other) noexcept;
+		NativeTask& operator = (NativeTask&& other) noexcept;
+		~NativeTask();
+
+		NativeTask(const NativeTask&) = delete;
+		NativeTask& operator = (const NativeTask&) = delete;
+
+		bool valid() const;
+		bool done() const;
+
+		// Runs the coroutine to its first suspension. `completion` runs once the coroutine has finished,
+		// on whichever thread resumed it last, and may be invoked before start() returns.
+		void start(std::function<void()> completion);
+
+		// The value of a finished task; rethrows whatever the native threw.
+		std::shared_ptr<RuntimeValue> result();
+
+		Awaiter operator co_await() && noexcept { return Awaiter{ handle }; }
+};
+
+// Arguments are taken by value: a coroutine outlives the call expression that produced them.
+using AsyncFunctionCall = std::function<NativeTask(std::vector<std::shared_ptr<RuntimeValue>>, Environment&)>;
+
+struct AsyncNativeFunctionValue : public RuntimeValue {
+	ValueType getType() const override {
+		return ValueType::asyncNativeFunction;
+	}
+
+	AsyncFunctionCall call;
+
+	AsyncNativeFunctionValue(AsyncFunctionCall fn) : call(std::move(fn)) {}
+};
+
+std::unique_ptr<AsyncNativeFunctionValue> MAKE_ASYNC_NATIVE_FUNCTION(AsyncFunctionCall call);
+
+enum class IoEvent {
+	Readable,
+	Writable
+};
+
+// Suspend the awaiting coroutine on the event loop of the current thread (see currentEventLoop).
+struct SleepAwaiter {
+	std::chrono::steady_clock::duration delay;
+
+	bool await_ready() const noexcept { return delay <= std::chrono::steady_clock::duration::zero(); }
+	void await_suspend(std::coroutine_handle<> handle) const;
+	void await_resume() const noexcept {}
+};
+
+struct IoAwaiter {
+	int fd;
+	IoEvent event;
+
+	bool await_ready() const noexcept { return false; }
+	void await_suspend(std::coroutine_handle<> handle) const;
+	void await_resume() const noexcept {}
+};
+
+SleepAwaiter sleepFor(std::chrono::steady_clock::duration delay);
+IoAwaiter waitReadable(int fd);
+IoAwaiter waitWritable(int fd);
+
+// Drives `task` to completion on a private event loop, blocking the calling thread. This is how
+// evaluate() and evaluateIterative() call async natives outside of EventLoop::spawn.
+std::shared_ptr<RuntimeValue> runNativeTask(NativeTask task);
+
+// Declares `sleep(milliseconds)`, which resolves to null once the delay has passed.
+void declareAsyncBuiltins(Environment& env);
@@ -0,0 +1,459 @@
+#include "batch.h"
+#include "interpreter.h"
+#include "memory.h"
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__AVX__)
+#define CINTER_BATCH_AVX 1
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CINTER_BATCH_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+constexpr std::size_t BATCH_BLOCK_SIZE = 1024;
+
+struct Operand {
+	const double* column = nullptr;
+	double scalar = 0.0;
+};
+
+enum class StepKind {
+	Column,
+	Constant,
+	Binary,
+	Fallback
+};
+
+struct BatchStep {
+	StepKind kind;
+	char _operator = '\0';
+	std::size_t lhs = 0;
+	std::size_t rhs = 0;
+	const double* column = nullptr;
+	double constant = 0.0;
+	const Expression* node = nullptr;
+	std::vector<std::string> rowVariables;
+	std::vector<double> buffer;
+};
+
+struct AddOp {
+	static double apply(double a, double b) { return a + b; }
+#if defined(CINTER_BATCH_AVX)
+	static __m256d apply(__m256d a, __m256d b) { return _mm256_add_pd(a, b); }
+#elif defined(CINTER_BATCH_SSE2)
+	static __m128d apply(__m128d a, __m128d b) { return _mm_add_pd(a, b); }
+#endif
+};
+
+struct SubOp {
+	static double apply(double a, double b) { return a - b; }
+#if defined(CINTER_BATCH_AVX)
+	static __m256d apply(__m256d a, __m256d b) { return _mm256_sub_pd(a, b); }
+#elif defined(CINTER_BATCH_SSE2)
+	static __m128d apply(__m128d a, __m128d b) { return _mm_sub_pd(a, b); }
+#endif
+};
+
+struct MulOp {
+	static double apply(double a, double b) { return a * b; }
+#if defined(CINTER_BATCH_AVX)
+	static __m256d apply(__m256d a, __m256d b) { return _mm256_mul_pd(a, b); }
+#elif defined(CINTER_BATCH_SSE2)
+	static __m128d apply(__m128d a, __m128d b) { return _mm_mul_pd(a, b); }
+#endif
+};
+
+struct DivOp {
+	static double apply(double a, double b) { return a / b; }
+#if defined(CINTER_BATCH_AVX)
+	static __m256d apply(__m256d a, __m256d b) { return _mm256_div_pd(a, b); }
+#elif defined(CINTER_BATCH_SSE2)
+	static __m128d apply(__m128d a, __m128d b) { return _mm_div_pd(a, b); }
+#endif
+};
+
+template <typename Op, bool LeftColumn, bool RightColumn>
+void runKernel(const Operand& lhs, const Operand& rhs, double* out, std::size_t count)
+{
+	std::size_t i = 0;
+
+#if defined(CINTER_BATCH_AVX)
+	const __m256d lhsBroadcast = _mm256_set1_pd(lhs.scalar);
+	const __m256d rhsBroadcast = _mm256_set1_pd(rhs.scalar);
+
+	for (; i + 4 <= count; i += 4) {
+		__m256d a = LeftColumn ? _mm256_loadu_pd(lhs.column + i) : lhsBroadcast;
+		__m256d b = RightColumn ? _mm256_loadu_pd(rhs.column + i) : rhsBroadcast;
+
+		_mm256_storeu_pd(out + i, Op::apply(a, b));
+	}
+#elif defined(CINTER_BATCH_SSE2)
+	const __m128d lhsBroadcast = _mm_set1_pd(lhs.scalar);
+	const __m128d rhsBroadcast = _mm_set1_pd(rhs.scalar);
+
+	for (; i + 2 <= count; i += 2) {
+		__m128d a = LeftColumn ? _mm_loadu_pd(lhs.column + i) : lhsBroadcast;
+		__m128d b = RightColumn ? _mm_loadu_pd(rhs.column + i) : rhsBroadcast;
+
+		_mm_storeu_pd(out + i, Op::apply(a, b));
+	}
+#endif
+
+	for (; i < count; ++i) {
+		double a = LeftColumn ? lhs.column[i] : lhs.scalar;
+		double b = RightColumn ? rhs.column[i] : rhs.scalar;
+
+		out[i] = Op::apply(a, b);
+	}
+}
+
+template <typename Op>
+void dispatchKernel(const Operand& lhs, const Operand& rhs, double* out, std::size_t count)
+{
+	if (lhs.column && rhs.column)
+		runKernel<Op, true, true>(lhs, rhs, out, count);
+
+	else if (lhs.column)
+		runKernel<Op, true, false>(lhs, rhs, out, count);
+
+	else
+		runKernel<Op, false, true>(lhs, rhs, out, count);
+}
+
+// There is no packed fmod, so `%` stays scalar to match evaluateNumericBinaryExpression exactly.
+void moduloKernel(const Operand& lhs, const Operand& rhs, double* out, std::size_t count)
+{
+	for (std::size_t i = 0; i < count; ++i) {
+		double a = lhs.column ? lhs.column[i] : lhs.scalar;
+		double b = rhs.column ? rhs.column[i] : rhs.scalar;
+
+		out[i] = std::fmod(a, b);
+	}
+}
+
+void collectColumnReferences(const Statement* node, const ColumnBindings& columns, std::set<std::string>& references, std::size_t depth = 0)
+{
+	if (!node)
+		return;
+
+	if (depth >= DEFAULT_RECURSIVE_NESTING_LIMIT)
+		throw NestingLimitExceeded("Batch planning", DEFAULT_RECURSIVE_NESTING_LIMIT);
+
+	switch (node->kind) {
+		case NodeType::Identifier: {
+			auto& identifier = static_cast<const _Identifier&>(*node);
+
+			if (columns.count(identifier.symbol))
+				references.insert(identifier.symbol);
+
+			break;
+		}
+		case NodeType::BinaryExpression: {
+			auto& binop = static_cast<const BinaryExpression&>(*node);
+
+			collectColumnReferences(binop.left.get(), columns, references, depth + 1);
+			collectColumnReferences(binop.right.get(), columns, references, depth + 1);
+			break;
+		}
+		case NodeType::AssignmentExpression: {
+			auto& assignment = static_cast<const AssignmentExpression&>(*node);
+
+			collectColumnReferences(assignment.assignee.get(), columns, references, depth + 1);
+			collectColumnReferences(assignment.value.get(), columns, references, depth + 1);
+			break;
+		}
+		case NodeType::ObjectLiteral: {
+			for (const auto& property : static_cast<const ObjectLiteral&>(*node).properties)
+				collectColumnReferences(property.get(), columns, references, depth + 1);
+
+			break;
+		}
+		case NodeType::Property: {
+			auto& property = static_cast<const Property&>(*node);
+
+			if (property.value)
+				collectColumnReferences(property.value.get(), columns, references, depth + 1);
+
+			else if (columns.count(property.key))
+				references.insert(property.key);
+
+			break;
+		}
+		case NodeType::MemberExpression: {
+			auto& member = static_cast<const MemberExpression&>(*node);
+
+			collectColumnReferences(member.object.get(), columns, references, depth + 1);
+
+			if (member.computed)
+				collectColumnReferences(member.property.get(), columns, references, depth + 1);
+
+			break;
+		}
+		case NodeType::CallExpression: {
+			auto& call = static_cast<const CallExpression&>(*node);
+
+			collectColumnReferences(call.caller.get(), columns, references, depth + 1);
+
+			for (const auto& arg : call.args)
+				collectColumnReferences(arg.get(), columns, references, depth + 1);
+
+			break;
+		}
+		default:
+			break;
+	}
+}
+
+double expectNumber(const std::shared_ptr<RuntimeValue>& value)
+{
+	if (!value || value->getType() != ValueType::Number)
+		throw std::runtime_error("Batch evaluation requires every operand to evaluate to a number.");
+
+	return static_cast<const NumberValue&>(*value).value;
+}
+
+class BatchPlan {
+	public:
+		BatchPlan(const Expression& root, const ColumnBindings& columns, Environment& env)
+			: columns(columns), env(env)
+		{
+			this->result = this->lower(root);
+
+			for (auto& step : this->steps) {
+				if (step.kind == StepKind::Binary || step.kind == StepKind::Fallback)
+					step.buffer.resize(BATCH_BLOCK_SIZE);
+			}
+		}
+
+		void run(double* output, std::size_t rows)
+		{
+			std::vector<Operand> operands(this->steps.size());
+
+			for (std::size_t offset = 0; offset < rows; offset += BATCH_BLOCK_SIZE) {
+				std::size_t count = std::min(BATCH_BLOCK_SIZE, rows - offset);
+
+				for (std::size_t index = 0; index < this->steps.size(); ++index) {
+					BatchStep& step = this->steps[index];
+					double* out = index == this->result ? output + offset : step.buffer.data();
+
+					operands[index] = this->runStep(step, operands, offset, count, out);
+				}
+
+				const Operand& produced = operands[this->result];
+
+				if (produced.column == output + offset)
+					continue;
+
+				if (produced.column)
+					std::copy(produced.column, produced.column + count, output + offset);
+
+				else
+					std::fill(output + offset, output + offset + count, produced.scalar);
+			}
+		}
+
+	private:
+		const ColumnBindings& columns;
+		Environment& env;
+		std::vector<BatchStep> steps;
+		std::size_t result = 0;
+
+		std::size_t push(BatchStep step)
+		{
+			this->steps.push_back(std::move(step));
+			return this->steps.size() - 1;
+		}
+
+		std::size_t pushConstant(double value)
+		{
+			BatchStep step {};
+			step.kind = StepKind::Constant;
+			step.constant = value;
+
+			return this->push(std::move(step));
+		}
+
+		std::size_t lower(const Expression& node, std::size_t depth = 0)
+		{
+			if (depth >= DEFAULT_RECURSIVE_NESTING_LIMIT)
+				throw NestingLimitExceeded("Batch planning", DEFAULT_RECURSIVE_NESTING_LIMIT);
+
+			switch (node.kind) {
+				case NodeType::NumericLiteral:
+					return this->pushConstant(static_cast<const NumericLiteral&>(node).value);
+
+				case NodeType::Identifier: {
+					auto& identifier = static_cast<const _Identifier&>(node);
+					auto column = this->columns.find(identifier.symbol);
+
+					if (column == this->columns.end())
+						return this->pushConstant(expectNumber(this->env.lookupVariable(identifier.symbol)));
+
+					BatchStep step {};
+					step.kind = StepKind::Column;
+					step.column = column->second;
+
+					return this->push(std::move(step));
+				}
+
+				case NodeType::BinaryExpression: {
+					auto& binop = static_cast<const BinaryExpression&>(node);
+
+					if (binop._operator.size() == 1 && std::string("+-*/%").find(binop._operator[0]) != std::string::npos) {
+						std::size_t lhs = this->lower(*binop.left, depth + 1);
+						std::size_t rhs = this->lower(*binop.right, depth + 1);
+
+						if (this->steps[lhs].kind == StepKind::Constant && this->steps[rhs].kind == StepKind::Constant) {
+							auto folded = evaluateNumericBinaryExpression(
+								NumberValue(this->steps[lhs].constant),
+								NumberValue(this->steps[rhs].constant),
+								binop._operator
+							);
+
+							return this->pushConstant(folded->value);
+						}
+
+						BatchStep step {};
+						step.kind = StepKind::Binary;
+						step._operator = binop._operator[0];
+						step.lhs = lhs;
+						step.rhs = rhs;
+
+						return this->push(std::move(step));
+					}
+
+					break;
+				}
+
+				default:
+					break;
+			}
+
+			return this->lowerFallback(node);
+		}
+
+		std::size_t lowerFallback(const Expression& node)
+		{
+			std::set<std::string> references;
+			collectColumnReferences(&node, this->columns, references);
+
+			if (references.empty())
+				return this->pushConstant(expectNumber(evaluate(node, this->env)));
+
+			BatchStep step {};
+			step.kind = StepKind::Fallback;
+			step.node = &node;
+			step.rowVariables.assign(references.begin(), references.end());
+
+			return this->push(std::move(step));
+		}
+
+		Operand runStep(BatchStep& step, const std::vector<Operand>& operands, std::size_t offset, std::size_t count, double* out)
+		{
+			Operand operand;
+
+			switch (step.kind) {
+				case StepKind::Constant:
+					operand.scalar = step.constant;
+					return operand;
+
+				case StepKind::Column:
+					operand.column = step.column + offset;
+					return operand;
+
+				case StepKind::Binary: {
+					const Operand& lhs = operands[step.lhs];
+					const Operand& rhs = operands[step.rhs];
+
+					switch (step._operator) {
+						case '+': dispatchKernel<AddOp>(lhs, rhs, out, count); break;
+						case '-': dispatchKernel<SubOp>(lhs, rhs, out, count); break;
+						case '*': dispatchKernel<MulOp>(lhs, rhs, out, count); break;
+						case '/': dispatchKernel<DivOp>(lhs, rhs, out, count); break;
+						default: moduloKernel(lhs, rhs, out, count); break;
+					}
+
+					operand.column = out;
+					return operand;
+				}
+
+				case StepKind::Fallback:
+					this->runFallback(step, offset, count, out);
+
+					operand.column = out;
+					return operand;
+			}
+
+			return operand;
+		}
+
+		void runFallback(const BatchStep& step, std::size_t offset, std::size_t count, double* out)
+		{
+			Environment rowEnv(std::shared_ptr<Environment>(std::shared_ptr<Environment>(), &this->env));
+			std::vector<const double*> inputs;
+
+			for (const auto& name : step.rowVariables) {
+				rowEnv.declareVariable(name, MAKE_NUMBER(), false);
+				inputs.push_back(this->columns.at(name) + offset);
+			}
+
+			for (std::size_t row = 0; row < count; ++row) {
+				for (std::size_t input = 0; input < inputs.size(); ++input)
+					rowEnv.assignVariable(step.rowVariables[input], MAKE_NUMBER(inputs[input][row]));
+
+				out[row] = expectNumber(evaluate(*step.node, rowEnv));
+			}
+		}
+};
+
+}
+
+void evaluateBatch(const Expression& expression, const ColumnBindings& columns, double* output, std::size_t rows, Environment& env)
+{
+	MemoryPhaseScope phase(MemoryPhase::Evaluator);
+	BatchPlan plan(expression, columns, env);
+
+	plan.run(output, rows);
+}
+
+void evaluateBatch(const Program& program, const ColumnBindings& columns, double* output, std::size_t rows, Environment& env)
+{
+	if (program.body.empty())
+		throw std::runtime_error("Cannot batch evaluate an empty program.");
+
+	Environment scope(std::shared_ptr<Environment>(std::shared_ptr<Environment>(), &env));
+
+	for (std::size_t index = 0; index + 1 < program.body.size(); ++index) {
+		evaluate(*program.body[index], scope);
+	}
+
+	const Statement& last = *program.body.back();
+	const Expression* expression = nullptr;
+
+	if (last.kind == NodeType::VariableDeclaration)
+		expression = static_cast<const VariableDeclaration&>(last).value.get();
+
+	else if (last.kind != NodeType::Program)
+		expression = static_cast<const Expression*>(&last);
+
+	if (!expression)
+		throw std::runtime_error("The final statement of a batch program must produce a value.");
+
+	// Only free identifiers read columns; a name the program declared itself keeps its own value.
+	ColumnBindings free;
+
+	for (const auto& column : columns) {
+		if (!scope.declaresVariable(column.first))
+			free.insert(column);
+	}
+
+	evaluateBatch(*expression, free, output, rows, scope);
+}
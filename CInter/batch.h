@@ -0,0 +1,17 @@
+#pragma once
+
+#include "ast.h"
+#include "environment.h"
+
+#include <cstddef>
+#include <map>
+#include <string>
+
+// Maps free identifiers to contiguous input columns of at least `rows` doubles.
+using ColumnBindings = std::map<std::string, const double*>;
+
+// Evaluates the final statement of `program` once per row, column-at-a-time, into `output`.
+// Earlier statements are run once (scalar) in a scope of their own and may be referenced as constants;
+// a name they declare is not free, so it refers to that declaration even where a column shares it.
+void evaluateBatch(const Program& program, const ColumnBindings& columns, double* output, std::size_t rows, Environment& env);
+void evaluateBatch(const Expression& expression, const ColumnBindings& columns, double* output, std::size_t rows, Environment& env);
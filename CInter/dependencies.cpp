@@ -0,0 +1,128 @@
+#include "dependencies.h"
+
+#include <vector>
+
+namespace {
+
+// The name a member-assignment chain like `a.b[c].d = ...` ultimately rebinds.
+const _Identifier* assignedRoot(const Expression& assignee)
+{
+	const Expression* node = &assignee;
+
+	while (node->kind == NodeType::MemberExpression) {
+		node = static_cast<const MemberExpression*>(node)->object.get();
+	}
+
+	return node->kind == NodeType::Identifier ? static_cast<const _Identifier*>(node) : nullptr;
+}
+
+}
+
+StatementDependencies analyzeStatement(const Statement& statement)
+{
+	StatementDependencies dependencies;
+	std::vector<const Statement*> pending = { &statement };
+
+	auto visit = [&pending](const Statement* node) {
+		if (node)
+			pending.push_back(node);
+	};
+
+	while (!pending.empty()) {
+		const Statement& node = *pending.back();
+		pending.pop_back();
+
+		switch (node.kind) {
+			case NodeType::Identifier:
+				dependencies.reads.insert(static_cast<const _Identifier&>(node).symbol);
+				break;
+
+			case NodeType::Program:
+				for (const auto& child : static_cast<const Program&>(node).body) {
+					visit(child.get());
+				}
+
+				break;
+
+			case NodeType::VariableDeclaration:
+				visit(static_cast<const VariableDeclaration&>(node).value.get());
+				break;
+
+			case NodeType::BinaryExpression: {
+				auto& binop = static_cast<const BinaryExpression&>(node);
+
+				visit(binop.left.get());
+				visit(binop.right.get());
+				break;
+			}
+
+			case NodeType::AssignmentExpression: {
+				auto& assignment = static_cast<const AssignmentExpression&>(node);
+
+				if (const _Identifier* root = assignedRoot(*assignment.assignee)) {
+					dependencies.writes.insert(root->symbol);
+				}
+
+				// Updating a member copies the object it belongs to, so the chain is read as well.
+				if (assignment.assignee->kind != NodeType::Identifier)
+					visit(assignment.assignee.get());
+
+				visit(assignment.value.get());
+				break;
+			}
+
+			case NodeType::ObjectLiteral:
+				for (const auto& property : static_cast<const ObjectLiteral&>(node).properties) {
+					visit(property.get());
+				}
+
+				break;
+
+			case NodeType::Property: {
+				auto& property = static_cast<const Property&>(node);
+
+				if (property.value)
+					visit(property.value.get());
+				else
+					dependencies.reads.insert(property.key);
+
+				break;
+			}
+
+			case NodeType::MemberExpression: {
+				auto& member = static_cast<const MemberExpression&>(node);
+
+				visit(member.object.get());
+
+				if (member.computed)
+					visit(member.property.get());
+
+				break;
+			}
+
+			case NodeType::CallExpression: {
+				auto& call = static_cast<const CallExpression&>(node);
+
+				dependencies.pure = false;
+
+				if (call.caller->kind == NodeType::Identifier)
+					dependencies.calls.insert(static_cast<const _Identifier&>(*call.caller).symbol);
+				else
+					dependencies.indirectCalls = true;
+
+				visit(call.caller.get());
+
+				for (const auto& argument : call.args) {
+					visit(argument.get());
+				}
+
+				break;
+			}
+
+			default:
+				break;
+		}
+	}
+
+	return dependencies;
+}
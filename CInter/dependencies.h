@@ -0,0 +1,21 @@
+#pragma once
+
+#include "ast.h"
+
+#include <set>
+#include <string>
+
+// Variables a statement touches. `writes` are names it assigns to (declarations are not writes).
+// A statement is impure when it may have effects the sets cannot describe, i.e. when it calls anything.
+struct StatementDependencies {
+	std::set<std::string> reads;
+	std::set<std::string> writes;
+	bool pure = true;
+
+	// Callees named directly, as `f` in `f(x)`. `indirectCalls` is set when some callee is any other
+	// expression; together they let a caller decide that the calls are harmless after all.
+	std::set<std::string> calls;
+	bool indirectCalls = false;
+};
+
+StatementDependencies analyzeStatement(const Statement& statement);
@@ -2,6 +2,7 @@
 
 #include "values.h"
 
+#include <functional>
 #include <iostream>
 #include <map>
 #include <set>
@@ -14,6 +15,7 @@ class Environment {
 		std::shared_ptr<Environment> parent;
 		std::map<std::string, std::shared_ptr<RuntimeValue>> variables;
 		std::set<std::string> constants;
+		std::function<void(const std::string&)> assignmentListener;
 	
 	public:
 		Environment(std::shared_ptr<Environment> parentENV = nullptr) : parent(parentENV) {}
@@ -40,10 +42,55 @@ class Environment {
             }
 
             env->variables[varname] = value;
+
+            if (env->assignmentListener) {
+                env->assignmentListener(varname);
+            }
             
             return value;
         }
 
+        // Replaces the value of a variable declared in this scope, constant or not. Used to re-run a
+        // declaration in place; the assignment listener is not notified.
+        std::shared_ptr<RuntimeValue> redeclareVariable(const std::string& varname, std::shared_ptr<RuntimeValue> value) {
+            auto it = variables.find(varname);
+
+            if (it == variables.end()) {
+                throw std::runtime_error("Cannot redeclare variable " + varname + " as it was never declared.");
+            }
+
+            it->second = value;
+
+            return value;
+        }
+
+        // Removes a variable declared in this scope itself; does nothing if there is none.
+        void undeclareVariable(const std::string& varname) {
+            variables.erase(varname);
+            constants.erase(varname);
+        }
+
+        // Called with the variable name after every successful assignVariable to a variable of this scope.
+        void setAssignmentListener(std::function<void(const std::string&)> listener) {
+            assignmentListener = std::move(listener);
+        }
+
+        // Whether `varname` is declared in this scope itself, ignoring parents.
+        bool declaresVariable(const std::string& varname) const {
+            return variables.find(varname) != variables.end();
+        }
+
+        bool isConstant(const std::string& varname) const {
+            return constants.find(varname) != constants.end();
+        }
+
+        // Visits the variables declared in this scope only, in name order.
+        void forEachVariable(const std::function<void(const std::string&, const std::shared_ptr<RuntimeValue>&)>& visit) const {
+            for (const auto& variable : variables) {
+                visit(variable.first, variable.second);
+            }
+        }
+
         std::shared_ptr<RuntimeValue> lookupVariable(const std::string& varname) {
             Environment* env = resolve(varname);
             
@@ -0,0 +1,503 @@
+#include "event_loop.h"
+#include "memory.h"
+
+#include <algorithm>
+#include <exception>
+#include <iterator>
+#include <stdexcept>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+thread_local EventLoop* currentEventLoop = nullptr;
+
+namespace {
+
+// Later deadlines sort first so the earliest timer sits at the front of the heap.
+bool laterTimer(const std::chrono::steady_clock::time_point& leftDeadline, std::uint64_t leftSequence,
+	const std::chrono::steady_clock::time_point& rightDeadline, std::uint64_t rightSequence)
+{
+	if (leftDeadline != rightDeadline)
+		return leftDeadline > rightDeadline;
+
+	return leftSequence > rightSequence;
+}
+
+class CurrentLoopScope {
+	private:
+		EventLoop* previous;
+
+	public:
+		CurrentLoopScope(EventLoop* loop) : previous(currentEventLoop) {
+			currentEventLoop = loop;
+		}
+
+		~CurrentLoopScope() {
+			currentEventLoop = previous;
+		}
+
+		CurrentLoopScope(const CurrentLoopScope&) = delete;
+		CurrentLoopScope& operator = (const CurrentLoopScope&) = delete;
+};
+
+}
+
+AsyncScript::AsyncScript(std::unique_ptr<Program> program, std::shared_ptr<Environment> env, ScriptBudget budget)
+	: program(std::move(program)), env(std::move(env)), budget(budget), machine(*this->program, *this->env),
+	lastEvaluated(MAKE_NULL())
+{
+	this->gauge.limit = budget.limit;
+}
+
+ScriptState AsyncScript::state() const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->status;
+}
+
+std::shared_ptr<RuntimeValue> AsyncScript::result() const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->lastEvaluated;
+}
+
+std::string AsyncScript::error() const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->failure;
+}
+
+std::uint64_t AsyncScript::fuelConsumed() const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->gauge.consumed;
+}
+
+std::uint64_t AsyncScript::suspensionCount() const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->suspensions;
+}
+
+void AsyncScript::wait()
+{
+	std::unique_lock<std::mutex> lock(this->mutex);
+
+	this->done.wait(lock, [this] {
+		return this->status == ScriptState::Finished || this->status == ScriptState::Failed;
+	});
+}
+
+EventLoop::EventLoop()
+{
+#if defined(__linux__)
+	this->epollFd = epoll_create1(EPOLL_CLOEXEC);
+
+	if (this->epollFd < 0)
+		throw std::runtime_error("Could not create the event loop's epoll instance.");
+
+	this->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	epoll_event event {};
+	event.events = EPOLLIN;
+	event.data.fd = this->wakeFd;
+
+	if (this->wakeFd < 0 || epoll_ctl(this->epollFd, EPOLL_CTL_ADD, this->wakeFd, &event) != 0) {
+		if (this->wakeFd >= 0)
+			close(this->wakeFd);
+
+		close(this->epollFd);
+		throw std::runtime_error("Could not create the event loop's wakeup descriptor.");
+	}
+#endif
+}
+
+EventLoop::~EventLoop()
+{
+#if defined(__linux__)
+	close(this->wakeFd);
+	close(this->epollFd);
+#endif
+}
+
+void EventLoop::post(std::function<void()> task)
+{
+	bool first;
+
+	{
+		std::lock_guard<std::mutex> lock(this->postMutex);
+
+		first = this->posted.empty();
+		this->posted.push_back(std::move(task));
+	}
+
+	if (first)
+		this->wake();
+}
+
+void EventLoop::callAt(std::chrono::steady_clock::time_point deadline, std::function<void()> callback)
+{
+	this->timers.push_back({ deadline, this->timerSequence++, std::move(callback) });
+
+	std::push_heap(this->timers.begin(), this->timers.end(), [](const Timer& left, const Timer& right) {
+		return laterTimer(left.deadline, left.sequence, right.deadline, right.sequence);
+	});
+}
+
+void EventLoop::callAfter(std::chrono::steady_clock::duration delay, std::function<void()> callback)
+{
+	this->callAt(std::chrono::steady_clock::now() + delay, std::move(callback));
+}
+
+void EventLoop::watch(int fd, IoEvent event, std::function<void()> callback)
+{
+#if defined(__linux__)
+	auto existing = this->watches.find(fd);
+	bool registered = existing != this->watches.end();
+	Watch& watch = this->watches[fd];
+	std::function<void()>& slot = event == IoEvent::Readable ? watch.readable : watch.writable;
+
+	if (slot)
+		throw std::runtime_error("A descriptor can only have one pending wait per direction.");
+
+	slot = std::move(callback);
+
+	try {
+		this->updateWatch(fd, registered);
+	}
+	catch (...) {
+		slot = nullptr;
+
+		if (!watch.readable && !watch.writable)
+			this->watches.erase(fd);
+
+		throw;
+	}
+#else
+	(void)fd;
+	(void)event;
+	(void)callback;
+
+	throw std::runtime_error("Waiting on file descriptors is only supported by the epoll event loop.");
+#endif
+}
+
+#if defined(__linux__)
+void EventLoop::updateWatch(int fd, bool registered)
+{
+	auto found = this->watches.find(fd);
+	std::uint32_t events = 0;
+
+	if (found != this->watches.end()) {
+		if (found->second.readable)
+			events |= EPOLLIN;
+
+		if (found->second.writable)
+			events |= EPOLLOUT;
+	}
+
+	if (!events) {
+		if (found != this->watches.end())
+			this->watches.erase(found);
+
+		if (registered)
+			epoll_ctl(this->epollFd, EPOLL_CTL_DEL, fd, nullptr);
+
+		return;
+	}
+
+	epoll_event event {};
+	event.events = events;
+	event.data.fd = fd;
+
+	if (epoll_ctl(this->epollFd, registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &event) != 0)
+		throw std::runtime_error("Could not watch descriptor " + std::to_string(fd) + ".");
+}
+#endif
+
+std::shared_ptr<AsyncScript> EventLoop::spawn(std::unique_ptr<Program> program, std::shared_ptr<Environment> env, ScriptBudget budget)
+{
+	if (budget.quantum <= 0)
+		throw std::invalid_argument("A script's fuel quantum must be positive.");
+
+	auto script = std::make_shared<AsyncScript>(std::move(program), std::move(env), budget);
+
+	this->retain();
+	this->post([this, script] { this->step(script); });
+
+	return script;
+}
+
+void EventLoop::retain()
+{
+	this->outstanding.fetch_add(1, std::memory_order_relaxed);
+}
+
+void EventLoop::release()
+{
+	if (this->outstanding.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		this->wake();
+}
+
+void EventLoop::stop()
+{
+	this->stopping.store(true);
+	this->wake();
+}
+
+// Runs one turn of a script: until it finishes, awaits an async native or spends its quantum.
+void EventLoop::step(const std::shared_ptr<AsyncScript>& script)
+{
+	{
+		std::lock_guard<std::mutex> lock(script->mutex);
+
+		script->status = ScriptState::Running;
+		script->gauge.remaining = std::min<std::int64_t>(script->gauge.remaining, 0) + script->budget.quantum;
+	}
+
+	FuelGauge gauge = script->gauge;
+	EvaluationMachine::Progress progress = EvaluationMachine::Progress::Finished;
+	std::string failure;
+	bool failed = false;
+
+	try {
+		FuelScope fuel(gauge);
+		MemoryScope memory(script->budget.memory.get(), MemoryPhase::Evaluator);
+
+		if (script->machine.awaiting())
+			script->machine.resumeWith(script->machine.pendingCall().result());
+
+		progress = script->machine.run(true);
+
+		// The completion keeps the script alive until the native is done with it.
+		if (progress == EvaluationMachine::Progress::Awaiting) {
+			{
+				std::lock_guard<std::mutex> lock(script->mutex);
+
+				script->gauge = gauge;
+				script->status = ScriptState::Queued;
+				++script->suspensions;
+			}
+
+			script->machine.pendingCall().start([this, script] {
+				this->post([this, script] { this->step(script); });
+			});
+
+			return;
+		}
+	}
+	catch (const std::exception& error) {
+		failed = true;
+		failure = error.what();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(script->mutex);
+		script->gauge = gauge;
+	}
+
+	if (failed) {
+		this->finish(*script, nullptr, &failure);
+	}
+	else if (progress == EvaluationMachine::Progress::Yielded) {
+		{
+			std::lock_guard<std::mutex> lock(script->mutex);
+			script->status = ScriptState::Queued;
+		}
+
+		this->ready.push_back([this, script] { this->step(script); });
+	}
+	else {
+		this->finish(*script, script->machine.result(), nullptr);
+	}
+}
+
+void EventLoop::finish(AsyncScript& script, std::shared_ptr<RuntimeValue> value, const std::string* failure)
+{
+	{
+		std::lock_guard<std::mutex> lock(script.mutex);
+
+		if (failure) {
+			script.status = ScriptState::Failed;
+			script.failure = *failure;
+		}
+		else {
+			script.status = ScriptState::Finished;
+			script.lastEvaluated = std::move(value);
+		}
+	}
+
+	script.done.notify_all();
+	this->release();
+}
+
+bool EventLoop::drainPosted()
+{
+	std::vector<std::function<void()>> tasks;
+
+	{
+		std::lock_guard<std::mutex> lock(this->postMutex);
+		tasks.swap(this->posted);
+	}
+
+	for (auto& task : tasks) {
+		this->ready.push_back(std::move(task));
+	}
+
+	return !tasks.empty();
+}
+
+void EventLoop::fireTimers()
+{
+	auto now = std::chrono::steady_clock::now();
+	auto later = [](const Timer& left, const Timer& right) {
+		return laterTimer(left.deadline, left.sequence, right.deadline, right.sequence);
+	};
+
+	while (!this->timers.empty() && this->timers.front().deadline <= now) {
+		std::pop_heap(this->timers.begin(), this->timers.end(), later);
+		this->ready.push_back(std::move(this->timers.back().callback));
+		this->timers.pop_back();
+	}
+}
+
+bool EventLoop::idle()
+{
+	if (!this->ready.empty() || !this->timers.empty() || this->outstanding.load(std::memory_order_acquire) != 0)
+		return false;
+
+#if defined(__linux__)
+	if (!this->watches.empty())
+		return false;
+#endif
+
+	std::lock_guard<std::mutex> lock(this->postMutex);
+	return this->posted.empty();
+}
+
+void EventLoop::wake()
+{
+#if defined(__linux__)
+	std::uint64_t one = 1;
+	ssize_t written = write(this->wakeFd, &one, sizeof(one));
+	(void)written;
+#else
+	{
+		std::lock_guard<std::mutex> lock(this->postMutex);
+		this->woken = true;
+	}
+
+	this->wakeup.notify_one();
+#endif
+}
+
+// Blocks until a posted task, a timer deadline, descriptor readiness or a wake() arrives.
+void EventLoop::wait()
+{
+	bool hasDeadline = !this->timers.empty();
+	auto deadline = hasDeadline ? this->timers.front().deadline : std::chrono::steady_clock::time_point();
+
+#if defined(__linux__)
+	int timeout = -1;
+
+	if (hasDeadline) {
+		auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+		timeout = static_cast<int>(std::clamp<std::chrono::milliseconds::rep>(remaining.count(), 0, 1 << 30));
+	}
+
+	epoll_event events[64];
+	int count = epoll_wait(this->epollFd, events, 64, timeout);
+
+	if (count < 0) {
+		if (errno == EINTR)
+			return;
+
+		throw std::runtime_error("The event loop failed to wait for events.");
+	}
+
+	for (int i = 0; i < count; ++i) {
+		int fd = events[i].data.fd;
+
+		if (fd == this->wakeFd) {
+			std::uint64_t value;
+			ssize_t drained = read(this->wakeFd, &value, sizeof(value));
+			(void)drained;
+			continue;
+		}
+
+		auto found = this->watches.find(fd);
+
+		if (found == this->watches.end())
+			continue;
+
+		std::uint32_t flags = events[i].events;
+		bool failed = (flags & (EPOLLERR | EPOLLHUP)) != 0;
+
+		if (found->second.readable && (failed || (flags & EPOLLIN)))
+			this->ready.push_back(std::move(found->second.readable));
+
+		if (found->second.writable && (failed || (flags & EPOLLOUT)))
+			this->ready.push_back(std::move(found->second.writable));
+
+		// A moved-from std::function is not guaranteed to be empty.
+		if (failed || (flags & EPOLLIN))
+			found->second.readable = nullptr;
+
+		if (failed || (flags & EPOLLOUT))
+			found->second.writable = nullptr;
+
+		this->updateWatch(fd, true);
+	}
+#else
+	std::unique_lock<std::mutex> lock(this->postMutex);
+	auto ready = [this] { return this->woken || !this->posted.empty(); };
+
+	if (hasDeadline)
+		this->wakeup.wait_until(lock, deadline, ready);
+	else
+		this->wakeup.wait(lock, ready);
+
+	this->woken = false;
+#endif
+}
+
+void EventLoop::run()
+{
+	CurrentLoopScope scope(this);
+
+	this->stopping.store(false);
+
+	while (!this->stopping.load()) {
+		this->drainPosted();
+		this->fireTimers();
+
+		if (!this->ready.empty()) {
+			std::deque<std::function<void()>> batch;
+			batch.swap(this->ready);
+
+			while (!batch.empty()) {
+				auto task = std::move(batch.front());
+				batch.pop_front();
+
+				try {
+					task();
+				}
+				catch (...) {
+					this->ready.insert(this->ready.begin(), std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+					throw;
+				}
+			}
+
+			continue;
+		}
+
+		if (this->idle())
+			break;
+
+		this->wait();
+	}
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "ast.h"
+#include "async.h"
+#include "environment.h"
+#include "iterative.h"
+#include "scheduler.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <unordered_map>
+#endif
+
+class EventLoop;
+
+// The loop running on this thread, if any; async awaiters register with it.
+extern thread_local EventLoop* currentEventLoop;
+
+// A program running on an EventLoop. It is parked while one of its calls awaits an async native,
+// and, like a scheduler Script, gives up the loop between top-level statements once its quantum is spent.
+class AsyncScript {
+	private:
+		friend class EventLoop;
+
+		std::unique_ptr<Program> program;
+		std::shared_ptr<Environment> env;
+		ScriptBudget budget;
+		FuelGauge gauge;
+		EvaluationMachine machine;
+		std::uint64_t suspensions = 0;
+
+		mutable std::mutex mutex;
+		std::condition_variable done;
+		ScriptState status = ScriptState::Queued;
+		std::shared_ptr<RuntimeValue> lastEvaluated;
+		std::string failure;
+
+	public:
+		AsyncScript(std::unique_ptr<Program> program, std::shared_ptr<Environment> env, ScriptBudget budget);
+
+		ScriptState state() const;
+		std::shared_ptr<RuntimeValue> result() const;
+		std::string error() const;
+		std::uint64_t fuelConsumed() const;
+		std::uint64_t suspensionCount() const;
+
+		// Must not be called from the thread running the loop.
+		void wait();
+};
+
+// A single-threaded reactor: ready callbacks, timers and, on Linux, file descriptor readiness
+// through epoll. Everything except post(), retain() and release() must be called on the loop's
+// thread or before run() starts. run() returns once nothing is left that could produce more work.
+class EventLoop {
+	private:
+		struct Timer {
+			std::chrono::steady_clock::time_point deadline;
+			std::uint64_t sequence;
+			std::function<void()> callback;
+		};
+
+		std::vector<Timer> timers;
+		std::uint64_t timerSequence = 0;
+		std::deque<std::function<void()>> ready;
+
+		std::mutex postMutex;
+		std::vector<std::function<void()>> posted;
+		std::atomic<std::size_t> outstanding { 0 };
+		std::atomic<bool> stopping { false };
+
+#if defined(__linux__)
+		struct Watch {
+			std::function<void()> readable;
+			std::function<void()> writable;
+		};
+
+		int epollFd = -1;
+		int wakeFd = -1;
+		std::unordered_map<int, Watch> watches;
+
+		void updateWatch(int fd, bool registered);
+#else
+		std::condition_variable wakeup;
+		bool woken = false;
+#endif
+
+		void step(const std::shared_ptr<AsyncScript>& script);
+		void finish(AsyncScript& script, std::shared_ptr<RuntimeValue> value, const std::string* failure);
+		bool drainPosted();
+		void fireTimers();
+		bool idle();
+		void wait();
+		void wake();
+
+	public:
+		EventLoop();
+		~EventLoop();
+
+		EventLoop(const EventLoop&) = delete;
+		EventLoop& operator = (const EventLoop&) = delete;
+
+		// Thread-safe; wakes the loop if it is blocked.
+		void post(std::function<void()> task);
+
+		void callAt(std::chrono::steady_clock::time_point deadline, std::function<void()> callback);
+		void callAfter(std::chrono::steady_clock::duration delay, std::function<void()> callback);
+
+		// One-shot: `callback` runs the first time `fd` becomes ready for `event` (or fails).
+		// Throws on targets without epoll.
+		void watch(int fd, IoEvent event, std::function<void()> callback);
+
+		std::shared_ptr<AsyncScript> spawn(std::unique_ptr<Program> program, std::shared_ptr<Environment> env, ScriptBudget budget = {});
+
+		// Keeps run() from returning while work started outside the loop may still post back to it.
+		void retain();
+		void release();
+
+		void run();
+		void stop();
+};
@@ -1,4 +1,10 @@
 #include "expressions.h"
+#include "async.h"
+#include "jit.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
 
 std::shared_ptr<NumberValue> evaluateNumericBinaryExpression(const NumberValue& lhs, const NumberValue& rhs, const std::string& _operator) {
 	double result;
@@ -26,26 +32,201 @@ std::shared_ptr<NumberValue> evaluateNumericBinaryExpression(const NumberValue&
 	return numberValue;
 }
 
-std::shared_ptr<RuntimeValue> evaluateBinaryExpression(BinaryExpression& binop, Environment& env) {
+std::shared_ptr<RuntimeValue> evaluateBinaryOperands(const std::shared_ptr<RuntimeValue>& lhs, const std::shared_ptr<RuntimeValue>& rhs, const std::string& _operator) {
+	if (lhs->getType() == ValueType::Number && rhs->getType() == ValueType::Number) {
+		return evaluateNumericBinaryExpression(
+			static_cast<const NumberValue&>(*lhs),
+			static_cast<const NumberValue&>(*rhs),
+			_operator
+		);
+	}
+
+	if (_operator == "+" && (lhs->getType() == ValueType::String || rhs->getType() == ValueType::String))
+		return concatenate(toStringValue(lhs), toStringValue(rhs));
 
+	return MAKE_NULL();
 }
 
-std::shared_ptr<_Identifier> evaluateIdentifier(_Identifier& ident, Environment& env)
+std::shared_ptr<RuntimeValue> evaluateBinaryExpression(const BinaryExpression& binop, Environment& env) {
+	if (jitEnabled()) {
+		if (auto compiled = evaluateCompiledExpression(binop, env))
+			return compiled;
+	}
+
+	auto lhs = evaluate(*binop.left, env);
+	auto rhs = evaluate(*binop.right, env);
+
+	return evaluateBinaryOperands(lhs, rhs, binop._operator);
+}
+
+std::shared_ptr<RuntimeValue> evaluateIdentifier(const _Identifier& ident, Environment& env)
 {
-	
+	return env.lookupVariable(ident.symbol);
 }
 
-std::shared_ptr<RuntimeValue> evaluateAssignment(AssignmentExpression& node, Environment& env)
+std::shared_ptr<StringValue> propertyKey(const std::shared_ptr<RuntimeValue>& key)
 {
-	
+	if (key->getType() == ValueType::String)
+		return std::static_pointer_cast<StringValue>(key);
+
+	if (key->getType() != ValueType::Number)
+		throw std::runtime_error("Computed property keys must evaluate to a string or a number.");
+
+	return MAKE_STRING(formatNumber(static_cast<const NumberValue&>(*key).value));
 }
 
-std::shared_ptr<RuntimeValue> evaluateObjectExpression(ObjectLiteral& obj, Environment& env)
+// The parser interns these; nodes built elsewhere fall back to the intern table.
+std::shared_ptr<StringValue> staticPropertyKey(const MemberExpression& member)
 {
-	
+	if (member.internedKey)
+		return member.internedKey;
+
+	return internString(static_cast<const _Identifier&>(*member.property).symbol);
 }
 
-std::shared_ptr<RuntimeValue> evaluateCallExpression(CallExpression& expression, Environment& env)
+std::shared_ptr<StringValue> staticPropertyKey(const Property& property)
 {
-	
+	return property.internedKey ? property.internedKey : internString(property.key);
+}
+
+std::shared_ptr<StringValue> evaluatePropertyKey(const MemberExpression& member, Environment& env)
+{
+	if (!member.computed)
+		return staticPropertyKey(member);
+
+	return propertyKey(evaluate(*member.property, env));
+}
+
+static const ObjectValue& expectObject(const std::shared_ptr<RuntimeValue>& value, const StringValue& key)
+{
+	if (!value || value->getType() != ValueType::Object)
+		throw std::runtime_error("Cannot access property " + std::string(key.view()) + " of a non-object value.");
+
+	return static_cast<const ObjectValue&>(*value);
+}
+
+std::shared_ptr<RuntimeValue> lookupProperty(const std::shared_ptr<RuntimeValue>& object, const StringValue& key)
+{
+	auto value = expectObject(object, key).properties.find(key.view(), key.hash());
+
+	return value ? *value : MAKE_NULL();
+}
+
+std::vector<const MemberExpression*> assignmentChain(const AssignmentExpression& node)
+{
+	std::vector<const MemberExpression*> chain;
+	const Expression* target = node.assignee.get();
+
+	while (target->kind == NodeType::MemberExpression) {
+		auto member = static_cast<const MemberExpression*>(target);
+
+		chain.push_back(member);
+		target = member->object.get();
+	}
+
+	if (chain.empty() || target->kind != NodeType::Identifier)
+		throw std::runtime_error("Invalid left-hand side in assignment expression.");
+
+	std::reverse(chain.begin(), chain.end());
+
+	return chain;
+}
+
+// Objects are persistent, so `a.b.c = v` rebuilds only the objects along the member chain and
+// rebinds `a`; anything else holding the previous object keeps seeing it unchanged.
+std::shared_ptr<RuntimeValue> assignMember(const std::vector<const MemberExpression*>& chain, const std::vector<std::shared_ptr<StringValue>>& keys, std::shared_ptr<RuntimeValue> value, Environment& env)
+{
+	const std::string& root = static_cast<const _Identifier&>(*chain.front()->object).symbol;
+	std::vector<std::shared_ptr<RuntimeValue>> objects;
+	std::shared_ptr<RuntimeValue> current = env.lookupVariable(root);
+
+	for (std::size_t i = 0; i < keys.size(); ++i) {
+		const ObjectValue& object = expectObject(current, *keys[i]);
+
+		objects.push_back(current);
+
+		if (i + 1 < keys.size()) {
+			auto next = object.properties.find(keys[i]->view(), keys[i]->hash());
+			current = next ? *next : MAKE_NULL();
+		}
+	}
+
+	std::shared_ptr<RuntimeValue> updated = value;
+
+	for (std::size_t i = objects.size(); i-- > 0;) {
+		updated = static_cast<const ObjectValue&>(*objects[i]).with(keys[i]->view(), keys[i]->hash(), updated);
+	}
+
+	env.assignVariable(root, updated);
+
+	return value;
+}
+
+std::shared_ptr<RuntimeValue> evaluateAssignment(const AssignmentExpression& node, Environment& env)
+{
+	if (node.assignee->kind == NodeType::Identifier) {
+		auto& identifier = static_cast<const _Identifier&>(*node.assignee);
+		return env.assignVariable(identifier.symbol, evaluate(*node.value, env));
+	}
+
+	auto chain = assignmentChain(node);
+	std::vector<std::shared_ptr<StringValue>> keys;
+
+	for (const MemberExpression* member : chain) {
+		keys.push_back(evaluatePropertyKey(*member, env));
+	}
+
+	return assignMember(chain, keys, evaluate(*node.value, env), env);
+}
+
+std::shared_ptr<RuntimeValue> evaluateObjectExpression(const ObjectLiteral& obj, Environment& env)
+{
+	PropertyMap properties;
+
+	for (const auto& property : obj.properties) {
+		auto value = property->value
+			? evaluate(*property->value, env)
+			: env.lookupVariable(property->key);
+
+		auto key = staticPropertyKey(*property);
+
+		properties = properties.set(key->view(), key->hash(), std::move(value));
+	}
+
+	return MAKE_OBJECT(std::move(properties));
+}
+
+std::shared_ptr<RuntimeValue> evaluateMemberExpression(const MemberExpression& member, Environment& env)
+{
+	auto object = evaluate(*member.object, env);
+
+	return lookupProperty(object, *evaluatePropertyKey(member, env));
+}
+
+std::shared_ptr<RuntimeValue> callFunction(const std::shared_ptr<RuntimeValue>& callee, std::vector<std::shared_ptr<RuntimeValue>> args, Environment& env)
+{
+	switch (callee->getType()) {
+		case ValueType::nativeFunction: {
+			auto result = static_cast<const NativeFunctionValue&>(*callee).call(args, env);
+			return result ? result : MAKE_NULL();
+		}
+
+		case ValueType::asyncNativeFunction:
+			return runNativeTask(static_cast<const AsyncNativeFunctionValue&>(*callee).call(std::move(args), env));
+
+		default:
+			throw std::runtime_error("Cannot call a value that is not a function.");
+	}
+}
+
+std::shared_ptr<RuntimeValue> evaluateCallExpression(const CallExpression& expression, Environment& env)
+{
+	auto callee = evaluate(*expression.caller, env);
+	std::vector<std::shared_ptr<RuntimeValue>> args;
+
+	for (const auto& argument : expression.args) {
+		args.push_back(evaluate(*argument, env));
+	}
+
+	return callFunction(callee, std::move(args), env);
 }
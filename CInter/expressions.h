@@ -4,11 +4,26 @@
 #include "ast.h"
 #include "interpreter.h"
 #include <memory>
+#include <string>
+#include <vector>
 #include <cmath>  
 
 std::shared_ptr<NumberValue> evaluateNumericBinaryExpression(const NumberValue& lhs, const NumberValue& rhs, const std::string& _operator);
-std::shared_ptr<RuntimeValue> evaluateBinaryExpression(const BinaryExpression& binop, const Environment& env);
-std::shared_ptr<_Identifier> evaluateIdentifier(_Identifier& ident, Environment& env);
-std::shared_ptr<RuntimeValue> evaluateAssignment(AssignmentExpression& node, Environment& env);
-std::shared_ptr<RuntimeValue> evaluateObjectExpression(ObjectLiteral& obj, Environment& env);
-std::shared_ptr<RuntimeValue> evaluateCallExpression(CallExpression& expression, Environment& env);
+std::shared_ptr<RuntimeValue> evaluateBinaryOperands(const std::shared_ptr<RuntimeValue>& lhs, const std::shared_ptr<RuntimeValue>& rhs, const std::string& _operator);
+std::shared_ptr<RuntimeValue> evaluateBinaryExpression(const BinaryExpression& binop, Environment& env);
+std::shared_ptr<RuntimeValue> evaluateIdentifier(const _Identifier& ident, Environment& env);
+std::shared_ptr<RuntimeValue> evaluateAssignment(const AssignmentExpression& node, Environment& env);
+std::shared_ptr<RuntimeValue> evaluateObjectExpression(const ObjectLiteral& obj, Environment& env);
+std::shared_ptr<RuntimeValue> evaluateMemberExpression(const MemberExpression& member, Environment& env);
+std::shared_ptr<StringValue> evaluatePropertyKey(const MemberExpression& member, Environment& env);
+std::shared_ptr<RuntimeValue> evaluateCallExpression(const CallExpression& expression, Environment& env);
+
+// Building blocks shared by the recursive and the iterative evaluator.
+// Property keys are strings that carry their own hash, so a key is never hashed twice.
+std::shared_ptr<StringValue> propertyKey(const std::shared_ptr<RuntimeValue>& key);
+std::shared_ptr<StringValue> staticPropertyKey(const MemberExpression& member);
+std::shared_ptr<StringValue> staticPropertyKey(const Property& property);
+std::shared_ptr<RuntimeValue> lookupProperty(const std::shared_ptr<RuntimeValue>& object, const StringValue& key);
+std::vector<const MemberExpression*> assignmentChain(const AssignmentExpression& node);
+std::shared_ptr<RuntimeValue> assignMember(const std::vector<const MemberExpression*>& chain, const std::vector<std::shared_ptr<StringValue>>& keys, std::shared_ptr<RuntimeValue> value, Environment& env);
+std::shared_ptr<RuntimeValue> callFunction(const std::shared_ptr<RuntimeValue>& callee, std::vector<std::shared_ptr<RuntimeValue>> args, Environment& env);
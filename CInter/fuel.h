@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+
+struct FuelExhausted : public std::runtime_error {
+	FuelExhausted() : std::runtime_error("Script ran out of fuel.") {}
+};
+
+// Fuel is charged once per evaluated AST node. A negative `remaining` means the current
+// time slice is spent; `limit` (when non-zero) is a hard cap on everything the script may consume.
+struct FuelGauge {
+	std::int64_t remaining = 0;
+	std::uint64_t consumed = 0;
+	std::uint64_t limit = 0;
+};
+
+extern thread_local FuelGauge* currentFuelGauge;
+
+inline void consumeFuel(std::uint64_t amount = 1)
+{
+	FuelGauge* gauge = currentFuelGauge;
+
+	if (!gauge)
+		return;
+
+	gauge->remaining -= static_cast<std::int64_t>(amount);
+	gauge->consumed += amount;
+
+	if (gauge->limit && gauge->consumed > gauge->limit)
+		throw FuelExhausted();
+}
+
+class FuelScope {
+	private:
+		FuelGauge* previous;
+
+	public:
+		FuelScope(FuelGauge& gauge) : previous(currentFuelGauge) {
+			currentFuelGauge = &gauge;
+		}
+
+		~FuelScope() {
+			currentFuelGauge = previous;
+		}
+
+		FuelScope(const FuelScope&) = delete;
+		FuelScope& operator = (const FuelScope&) = delete;
+};
@@ -1,55 +1,114 @@
 #include "interpreter.h"
+#include "fuel.h"
 
-std::shared_ptr<RuntimeValue> evaluate(const std::shared_ptr<Expression>& astNode, Environment& env)
+#include <atomic>
+
+thread_local FuelGauge* currentFuelGauge = nullptr;
+
+namespace {
+
+std::atomic<std::size_t> maxEvaluationDepth { DEFAULT_RECURSIVE_NESTING_LIMIT };
+thread_local std::size_t evaluationDepth = 0;
+
+struct EvaluationDepthGuard {
+	EvaluationDepthGuard() {
+		std::size_t limit = maxEvaluationDepth.load(std::memory_order_relaxed);
+
+		if (evaluationDepth >= limit)
+			throw NestingLimitExceeded("Evaluation", limit);
+
+		++evaluationDepth;
+	}
+
+	~EvaluationDepthGuard() {
+		--evaluationDepth;
+	}
+};
+
+}
+
+void setMaxEvaluationDepth(std::size_t depth)
+{
+	maxEvaluationDepth.store(depth, std::memory_order_relaxed);
+}
+
+std::shared_ptr<RuntimeValue> evaluate(const Statement& astNode, Environment& env)
 {
-	switch (astNode->kind)
+	EvaluationDepthGuard depthGuard;
+
+	consumeFuel();
+
+	switch (astNode.kind)
 	{
 		case NodeType::NumericLiteral:
 		{
-			auto numericLiteral = std::dynamic_pointer_cast<NumericLiteral>(astNode);
-			return std::make_shared<NumberValue>(numericLiteral->value);
+			auto& numericLiteral = static_cast<const NumericLiteral&>(astNode);
+			return std::make_shared<NumberValue>(numericLiteral.value);
+		}
+
+		case NodeType::StringLiteral:
+		{
+			auto& stringLiteral = static_cast<const StringLiteral&>(astNode);
+			return stringLiteral.value;
 		}
 
 		case NodeType::BinaryExpression:
 		{
-			auto binaryExpression = std::dynamic_pointer_cast<BinaryExpression>(astNode);
-			return evaluateBinaryExpression(*binaryExpression, env);
+			auto& binaryExpression = static_cast<const BinaryExpression&>(astNode);
+			return evaluateBinaryExpression(binaryExpression, env);
 		}
 		
 		case NodeType::Identifier:
 		{
-
+			auto& identifier = static_cast<const _Identifier&>(astNode);
+			return evaluateIdentifier(identifier, env);
 		}
 
 		
 		case NodeType::Program:
 		{
+			auto& program = static_cast<const Program&>(astNode);
+			return evaluateProgram(program, env);
+		}
 
+		case NodeType::VariableDeclaration:
+		{
+			auto& declaration = static_cast<const VariableDeclaration&>(astNode);
+			return evaluateVariableDeclaration(declaration, env);
 		}
 
 		case NodeType::ObjectLiteral:
 		{
-
+			auto& objectLiteral = static_cast<const ObjectLiteral&>(astNode);
+			return evaluateObjectExpression(objectLiteral, env);
 		}
 
-		case NodeType::VariableDeclaration:
+		case NodeType::MemberExpression:
 		{
-
+			auto& memberExpression = static_cast<const MemberExpression&>(astNode);
+			return evaluateMemberExpression(memberExpression, env);
 		}
 
-		case NodeType::CallExpression:
+		case NodeType::AssignmentExpression:
 		{
-
+			auto& assignment = static_cast<const AssignmentExpression&>(astNode);
+			return evaluateAssignment(assignment, env);
 		}
 
-		case NodeType::AssignmentExpression:
+		case NodeType::ImportDeclaration:
 		{
+			auto& importDeclaration = static_cast<const ImportDeclaration&>(astNode);
+			return evaluateImportDeclaration(importDeclaration, env);
+		}
 
+		case NodeType::CallExpression:
+		{
+			auto& callExpression = static_cast<const CallExpression&>(astNode);
+			return evaluateCallExpression(callExpression, env);
 		}
 
 		default:
-			std::cerr << "This AST Node has not yet been setup for interpretation. ";
-			exit(0);
+			throw std::runtime_error("This AST Node has not yet been setup for interpretation.");
 	}
 
 	return nullptr;
@@ -2,6 +2,12 @@
 
 #include "ast.h"
 #include "values.h"
+#include "environment.h"
 #include "expressions.h"
+#include "statement.h"
+#include "nesting.h"
 
-std::shared_ptr<RuntimeValue> evaluate(std::shared_ptr<Statement>& astNode, Environment& env);
\ No newline at end of file
+std::shared_ptr<RuntimeValue> evaluate(const Statement& astNode, Environment& env);
+
+// Caps how deeply the recursive evaluate() may nest before reporting NestingLimitExceeded.
+void setMaxEvaluationDepth(std::size_t depth);
\ No newline at end of file
@@ -0,0 +1,332 @@
+#include "iterative.h"
+#include "interpreter.h"
+#include "fuel.h"
+#include "jit.h"
+#include "memory.h"
+
+#include <stdexcept>
+#include <vector>
+
+EvaluationMachine::EvaluationMachine(const Statement& root, Environment& env, std::size_t maxDepth)
+	: root(root), env(env), maxDepth(maxDepth)
+{
+}
+
+void EvaluationMachine::push(const Statement& node)
+{
+	if (this->frames.size() >= this->maxDepth)
+		throw NestingLimitExceeded("Evaluation", this->maxDepth);
+
+	consumeFuel();
+	this->frames.push_back({ &node, 0, {} });
+}
+
+std::shared_ptr<RuntimeValue> EvaluationMachine::pop()
+{
+	auto value = std::move(this->values.back());
+	this->values.pop_back();
+	return value;
+}
+
+bool EvaluationMachine::awaiting() const
+{
+	return this->call.valid() || this->callee;
+}
+
+NativeTask& EvaluationMachine::pendingCall()
+{
+	return this->call;
+}
+
+void EvaluationMachine::resumeWith(std::shared_ptr<RuntimeValue> value)
+{
+	if (!this->awaiting())
+		throw std::logic_error("The evaluation is not waiting for a call.");
+
+	this->values.push_back(value ? std::move(value) : MAKE_NULL());
+	this->frames.pop_back();
+	this->call = NativeTask();
+	this->callee.reset();
+}
+
+std::shared_ptr<RuntimeValue> EvaluationMachine::result()
+{
+	if (!this->started || !this->frames.empty() || this->values.empty())
+		throw std::logic_error("The evaluation has not finished.");
+
+	return this->values.back();
+}
+
+EvaluationMachine::Progress EvaluationMachine::run(bool preemptible)
+{
+	MemoryPhaseScope phase(MemoryPhase::Evaluator);
+
+	if (this->awaiting())
+		throw std::logic_error("Cannot continue an evaluation that is waiting for a call.");
+
+	if (!this->started) {
+		this->started = true;
+		this->push(this->root);
+	}
+
+	auto& frames = this->frames;
+	auto& values = this->values;
+	auto& env = this->env;
+
+	while (!frames.empty()) {
+		// Every pending value and stage lives in the stacks, so the machine can stop at any node.
+		if (preemptible && currentFuelGauge && currentFuelGauge->remaining <= 0)
+			return Progress::Yielded;
+
+		Frame& frame = frames.back();
+		const Statement& node = *frame.node;
+
+		switch (node.kind) {
+			case NodeType::NumericLiteral:
+				values.push_back(MAKE_NUMBER(static_cast<const NumericLiteral&>(node).value));
+				frames.pop_back();
+				break;
+
+			case NodeType::StringLiteral:
+				values.push_back(static_cast<const StringLiteral&>(node).value);
+				frames.pop_back();
+				break;
+
+			case NodeType::Identifier:
+				values.push_back(evaluateIdentifier(static_cast<const _Identifier&>(node), env));
+				frames.pop_back();
+				break;
+
+			case NodeType::BinaryExpression: {
+				auto& binop = static_cast<const BinaryExpression&>(node);
+
+				if (frame.stage == 0) {
+					std::shared_ptr<RuntimeValue> compiled;
+
+					if (jitEnabled() && (compiled = evaluateCompiledExpression(binop, env))) {
+						values.push_back(std::move(compiled));
+						frames.pop_back();
+						break;
+					}
+
+					frame.stage = 1;
+					this->push(*binop.left);
+				}
+				else if (frame.stage == 1) {
+					frame.stage = 2;
+					this->push(*binop.right);
+				}
+				else {
+					auto rhs = this->pop();
+					auto lhs = this->pop();
+
+					values.push_back(evaluateBinaryOperands(lhs, rhs, binop._operator));
+					frames.pop_back();
+				}
+
+				break;
+			}
+
+			case NodeType::Program: {
+				auto& program = static_cast<const Program&>(node);
+				std::size_t next = frame.stage;
+
+				++frame.stage;
+
+				if (next > 0 && next < program.body.size())
+					values.pop_back();
+
+				if (next < program.body.size()) {
+					this->push(*program.body[next]);
+				}
+				else {
+					if (program.body.empty())
+						values.push_back(MAKE_NULL());
+
+					frames.pop_back();
+				}
+
+				break;
+			}
+
+			case NodeType::VariableDeclaration: {
+				auto& declaration = static_cast<const VariableDeclaration&>(node);
+
+				if (frame.stage == 0 && declaration.value) {
+					frame.stage = 1;
+					this->push(*declaration.value);
+					break;
+				}
+
+				std::shared_ptr<RuntimeValue> value = declaration.value ? this->pop() : MAKE_NULL();
+
+				values.push_back(env.declareVariable(declaration.identifier, value, declaration.constant));
+				frames.pop_back();
+				break;
+			}
+
+			case NodeType::AssignmentExpression: {
+				auto& assignment = static_cast<const AssignmentExpression&>(node);
+
+				if (assignment.assignee->kind == NodeType::Identifier) {
+					if (frame.stage == 0) {
+						frame.stage = 1;
+						this->push(*assignment.value);
+						break;
+					}
+
+					auto& identifier = static_cast<const _Identifier&>(*assignment.assignee);
+
+					values.push_back(env.assignVariable(identifier.symbol, this->pop()));
+					frames.pop_back();
+					break;
+				}
+
+				// Computed keys along the chain first, root to leaf, then the assigned value.
+				if (frame.stage == 0)
+					frame.chain = assignmentChain(assignment);
+
+				std::size_t stage = frame.stage;
+
+				if (stage < frame.chain.size()) {
+					++frame.stage;
+
+					if (frame.chain[stage]->computed)
+						this->push(*frame.chain[stage]->property);
+
+					break;
+				}
+
+				if (stage == frame.chain.size()) {
+					++frame.stage;
+					this->push(*assignment.value);
+					break;
+				}
+
+				auto chain = std::move(frame.chain);
+				auto value = this->pop();
+				std::vector<std::shared_ptr<StringValue>> keys(chain.size());
+
+				for (std::size_t i = chain.size(); i-- > 0;) {
+					keys[i] = chain[i]->computed
+						? propertyKey(this->pop())
+						: staticPropertyKey(*chain[i]);
+				}
+
+				values.push_back(assignMember(chain, keys, std::move(value), env));
+				frames.pop_back();
+				break;
+			}
+
+			case NodeType::ObjectLiteral: {
+				auto& object = static_cast<const ObjectLiteral&>(node);
+
+				if (frame.stage < object.properties.size()) {
+					const Property& property = *object.properties[frame.stage++];
+
+					if (property.value)
+						this->push(*property.value);
+					else
+						values.push_back(env.lookupVariable(property.key));
+
+					break;
+				}
+
+				PropertyMap properties;
+				std::size_t first = values.size() - object.properties.size();
+
+				for (std::size_t i = 0; i < object.properties.size(); ++i) {
+					auto key = staticPropertyKey(*object.properties[i]);
+
+					properties = properties.set(key->view(), key->hash(), std::move(values[first + i]));
+				}
+
+				values.resize(first);
+				values.push_back(MAKE_OBJECT(std::move(properties)));
+				frames.pop_back();
+				break;
+			}
+
+			case NodeType::MemberExpression: {
+				auto& member = static_cast<const MemberExpression&>(node);
+
+				if (frame.stage == 0) {
+					frame.stage = 1;
+					this->push(*member.object);
+					break;
+				}
+
+				if (frame.stage == 1 && member.computed) {
+					frame.stage = 2;
+					this->push(*member.property);
+					break;
+				}
+
+				auto key = member.computed
+					? propertyKey(this->pop())
+					: staticPropertyKey(member);
+
+				auto object = this->pop();
+
+				values.push_back(lookupProperty(object, *key));
+				frames.pop_back();
+				break;
+			}
+
+			case NodeType::CallExpression: {
+				auto& call = static_cast<const CallExpression&>(node);
+
+				if (frame.stage == 0) {
+					frame.stage = 1;
+					this->push(*call.caller);
+					break;
+				}
+
+				if (frame.stage <= call.args.size()) {
+					std::size_t argument = frame.stage++ - 1;
+					this->push(*call.args[argument]);
+					break;
+				}
+
+				std::size_t first = values.size() - call.args.size();
+				std::vector<std::shared_ptr<RuntimeValue>> args(
+					std::make_move_iterator(values.begin() + first),
+					std::make_move_iterator(values.end())
+				);
+
+				values.resize(first);
+
+				auto callee = this->pop();
+
+				// The frame stays on the stack until resumeWith() delivers the value.
+				if (callee->getType() == ValueType::asyncNativeFunction) {
+					this->call = static_cast<const AsyncNativeFunctionValue&>(*callee).call(std::move(args), env);
+					this->callee = std::move(callee);
+					return Progress::Awaiting;
+				}
+
+				values.push_back(callFunction(callee, std::move(args), env));
+				frames.pop_back();
+				break;
+			}
+
+			default:
+				values.push_back(evaluate(node, env));
+				frames.pop_back();
+				break;
+		}
+	}
+
+	return Progress::Finished;
+}
+
+std::shared_ptr<RuntimeValue> evaluateIterative(const Statement& astNode, Environment& env, std::size_t maxDepth)
+{
+	EvaluationMachine machine(astNode, env, maxDepth);
+
+	while (machine.run() == EvaluationMachine::Progress::Awaiting) {
+		machine.resumeWith(runNativeTask(std::move(machine.pendingCall())));
+	}
+
+	return machine.result();
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "ast.h"
+#include "async.h"
+#include "environment.h"
+#include "nesting.h"
+
+#include <memory>
+#include <vector>
+
+// Evaluates a tree with a heap-allocated work stack; memory grows linearly with nesting depth and
+// exceeding `maxDepth` pending nodes throws NestingLimitExceeded instead of overflowing the C++ stack.
+// Because all of its state lives in that stack, the machine can stop at a call to an async native
+// and be resumed later with the call's value, or give up its thread in the middle of any statement.
+class EvaluationMachine {
+	public:
+		enum class Progress {
+			Finished,
+			Awaiting,
+			Yielded
+		};
+
+	private:
+		struct Frame {
+			const Statement* node;
+			std::size_t stage;
+
+			// The member chain of an assignment, resolved once when the frame starts.
+			std::vector<const MemberExpression*> chain;
+		};
+
+		const Statement& root;
+		Environment& env;
+		std::size_t maxDepth;
+		bool started = false;
+
+		std::vector<Frame> frames;
+		std::vector<std::shared_ptr<RuntimeValue>> values;
+
+		std::shared_ptr<RuntimeValue> callee;
+		NativeTask call;
+
+		void push(const Statement& node);
+		std::shared_ptr<RuntimeValue> pop();
+
+	public:
+		EvaluationMachine(const Statement& root, Environment& env, std::size_t maxDepth = DEFAULT_ITERATIVE_NESTING_LIMIT);
+
+		// With `preemptible`, returns Yielded before the next node once the current fuel slice is spent.
+		Progress run(bool preemptible = false);
+
+		bool awaiting() const;
+		NativeTask& pendingCall();
+
+		// Supplies the value of the pending call so that run() can continue after it.
+		void resumeWith(std::shared_ptr<RuntimeValue> value);
+
+		std::shared_ptr<RuntimeValue> result();
+};
+
+// Runs an EvaluationMachine to the end, driving any async native it awaits with runNativeTask.
+std::shared_ptr<RuntimeValue> evaluateIterative(const Statement& astNode, Environment& env, std::size_t maxDepth = DEFAULT_ITERATIVE_NESTING_LIMIT);
@@ -0,0 +1,599 @@
+#include "jit.h"
+#include "interpreter.h"
+#include "expressions.h"
+#include "fuel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <unordered_map>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CINTER_JIT_X64 1
+#endif
+
+#if defined(CINTER_JIT_X64)
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#endif
+
+namespace {
+
+std::atomic<bool> enabled { false };
+std::atomic<std::uint32_t> threshold { 16 };
+
+#if defined(CINTER_JIT_X64)
+
+// Win64 only treats xmm0-xmm5 as volatile; System V lets a leaf function use all sixteen.
+#if defined(_WIN32)
+constexpr unsigned AVAILABLE_REGISTERS = 6;
+constexpr std::uint8_t SLOTS_REGISTER = 1;
+#else
+constexpr unsigned AVAILABLE_REGISTERS = 16;
+constexpr std::uint8_t SLOTS_REGISTER = 7;
+#endif
+
+std::size_t pageSize()
+{
+#if defined(_WIN32)
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+
+	return info.dwPageSize;
+#else
+	return static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+// Maps `code` read-write, copies it in, then flips the pages to read-execute.
+void* mapExecutable(const std::vector<std::uint8_t>& code, std::size_t& size)
+{
+	std::size_t page = pageSize();
+	size = (code.size() + page - 1) / page * page;
+
+#if defined(_WIN32)
+	void* memory = VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+
+	if (!memory)
+		return nullptr;
+
+	std::memcpy(memory, code.data(), code.size());
+
+	DWORD previous;
+
+	if (!VirtualProtect(memory, size, PAGE_EXECUTE_READ, &previous)) {
+		VirtualFree(memory, 0, MEM_RELEASE);
+		return nullptr;
+	}
+
+	FlushInstructionCache(GetCurrentProcess(), memory, size);
+#else
+	void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (memory == MAP_FAILED)
+		return nullptr;
+
+	std::memcpy(memory, code.data(), code.size());
+
+	if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+		munmap(memory, size);
+		return nullptr;
+	}
+#endif
+
+	return memory;
+}
+
+void unmapExecutable(void* memory, std::size_t size)
+{
+#if defined(_WIN32)
+	(void)size;
+	VirtualFree(memory, 0, MEM_RELEASE);
+#else
+	munmap(memory, size);
+#endif
+}
+
+class Assembler {
+	private:
+		std::vector<std::uint8_t>& code;
+
+		void rex(bool wide, unsigned reg, unsigned rm)
+		{
+			std::uint8_t prefix = 0x40 | (wide ? 0x08 : 0) | ((reg & 8) ? 0x04 : 0) | ((rm & 8) ? 0x01 : 0);
+
+			if (prefix != 0x40)
+				this->code.push_back(prefix);
+		}
+
+		void modrm(unsigned mod, unsigned reg, unsigned rm)
+		{
+			this->code.push_back(static_cast<std::uint8_t>((mod << 6) | ((reg & 7) << 3) | (rm & 7)));
+		}
+
+	public:
+		Assembler(std::vector<std::uint8_t>& code) : code(code) {}
+
+		// addsd/subsd/mulsd/divsd dst, src
+		void arithmetic(std::uint8_t opcode, unsigned dst, unsigned src)
+		{
+			this->code.push_back(0xF2);
+			this->rex(false, dst, src);
+			this->code.push_back(0x0F);
+			this->code.push_back(opcode);
+			this->modrm(3, dst, src);
+		}
+
+		// movsd dst, [slots + 8 * index]
+		void loadSlot(unsigned dst, std::uint32_t index)
+		{
+			std::uint32_t displacement = index * 8;
+
+			this->code.push_back(0xF2);
+			this->rex(false, dst, SLOTS_REGISTER);
+			this->code.push_back(0x0F);
+			this->code.push_back(0x10);
+			this->modrm(2, dst, SLOTS_REGISTER);
+
+			for (int byte = 0; byte < 4; ++byte)
+				this->code.push_back(static_cast<std::uint8_t>(displacement >> (byte * 8)));
+		}
+
+		// mov rax, imm64; movq dst, rax
+		void loadConstant(unsigned dst, double value)
+		{
+			std::uint64_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+
+			this->code.push_back(0x48);
+			this->code.push_back(0xB8);
+
+			for (int byte = 0; byte < 8; ++byte)
+				this->code.push_back(static_cast<std::uint8_t>(bits >> (byte * 8)));
+
+			this->code.push_back(0x66);
+			this->rex(true, dst, 0);
+			this->code.push_back(0x0F);
+			this->code.push_back(0x6E);
+			this->modrm(3, dst, 0);
+		}
+
+		// movapd dst, src
+		void move(unsigned dst, unsigned src)
+		{
+			this->code.push_back(0x66);
+			this->rex(false, dst, src);
+			this->code.push_back(0x0F);
+			this->code.push_back(0x28);
+			this->modrm(3, dst, src);
+		}
+
+		void ret()
+		{
+			this->code.push_back(0xC3);
+		}
+};
+
+#endif
+
+std::uint8_t opcodeFor(const std::string& _operator)
+{
+	if (_operator == "+") return 0x58;
+	if (_operator == "*") return 0x59;
+	if (_operator == "-") return 0x5C;
+	if (_operator == "/") return 0x5E;
+
+	return 0;
+}
+
+using RegisterNeeds = std::unordered_map<const Expression*, unsigned>;
+
+// Sethi-Ullman register need of a compilable tree, or 0 when the tree cannot be compiled. Records
+// the need of every node on the way, so emit() can order the children without recomputing it.
+unsigned registerNeed(const Expression& node, RegisterNeeds& needs, std::size_t depth = 0)
+{
+	if (depth >= DEFAULT_RECURSIVE_NESTING_LIMIT)
+		return 0;
+
+	unsigned need = 0;
+
+	switch (node.kind) {
+		case NodeType::NumericLiteral:
+		case NodeType::Identifier:
+			need = 1;
+			break;
+
+		case NodeType::BinaryExpression: {
+			auto& binop = static_cast<const BinaryExpression&>(node);
+
+			if (!opcodeFor(binop._operator))
+				return 0;
+
+			unsigned left = registerNeed(*binop.left, needs, depth + 1);
+			unsigned right = left ? registerNeed(*binop.right, needs, depth + 1) : 0;
+
+			if (!left || !right)
+				return 0;
+
+			need = left == right ? left + 1 : std::max(left, right);
+			break;
+		}
+
+		default:
+			return 0;
+	}
+
+	needs[&node] = need;
+
+	return need;
+}
+
+#if defined(CINTER_JIT_X64)
+
+std::uint32_t slotFor(const std::string& name, std::vector<std::string>& variables)
+{
+	auto existing = std::find(variables.begin(), variables.end(), name);
+
+	if (existing != variables.end())
+		return static_cast<std::uint32_t>(existing - variables.begin());
+
+	variables.push_back(name);
+	return static_cast<std::uint32_t>(variables.size() - 1);
+}
+
+// Leaves the value of `node` in xmm`target`, using only xmm`target` and above.
+void emit(Assembler& assembler, const Expression& node, unsigned target, const RegisterNeeds& needs, std::vector<std::string>& variables)
+{
+	switch (node.kind) {
+		case NodeType::NumericLiteral:
+			assembler.loadConstant(target, static_cast<const NumericLiteral&>(node).value);
+			break;
+
+		case NodeType::Identifier:
+			assembler.loadSlot(target, slotFor(static_cast<const _Identifier&>(node).symbol, variables));
+			break;
+
+		default: {
+			auto& binop = static_cast<const BinaryExpression&>(node);
+			std::uint8_t opcode = opcodeFor(binop._operator);
+
+			// Slots are numbered in the interpreter's left-to-right lookup order before any code
+			// is emitted, so reordering the children below cannot change which lookup fails first.
+			if (needs.at(binop.left.get()) >= needs.at(binop.right.get())) {
+				emit(assembler, *binop.left, target, needs, variables);
+				emit(assembler, *binop.right, target + 1, needs, variables);
+				assembler.arithmetic(opcode, target, target + 1);
+			}
+			else {
+				emit(assembler, *binop.right, target, needs, variables);
+				emit(assembler, *binop.left, target + 1, needs, variables);
+				assembler.arithmetic(opcode, target + 1, target);
+				assembler.move(target, target + 1);
+			}
+
+			break;
+		}
+	}
+}
+
+void collectVariables(const Expression& node, std::vector<std::string>& variables, std::uint64_t& nodes)
+{
+	++nodes;
+
+	if (node.kind == NodeType::Identifier) {
+		slotFor(static_cast<const _Identifier&>(node).symbol, variables);
+	}
+	else if (node.kind == NodeType::BinaryExpression) {
+		auto& binop = static_cast<const BinaryExpression&>(node);
+
+		collectVariables(*binop.left, variables, nodes);
+		collectVariables(*binop.right, variables, nodes);
+	}
+}
+
+#endif
+
+}
+
+CompiledExpression::~CompiledExpression()
+{
+#if defined(CINTER_JIT_X64)
+	if (this->memory)
+		unmapExecutable(this->memory, this->size);
+#endif
+}
+
+bool jitAvailable()
+{
+#if defined(CINTER_JIT_X64)
+	return true;
+#else
+	return false;
+#endif
+}
+
+void setJitEnabled(bool value)
+{
+	enabled.store(value && jitAvailable(), std::memory_order_relaxed);
+}
+
+bool jitEnabled()
+{
+	return enabled.load(std::memory_order_relaxed);
+}
+
+void setJitThreshold(std::uint32_t evaluations)
+{
+	threshold.store(evaluations, std::memory_order_relaxed);
+}
+
+std::shared_ptr<CompiledExpression> compileNumericExpression(const BinaryExpression& binop)
+{
+#if defined(CINTER_JIT_X64)
+	RegisterNeeds needs;
+	unsigned need = registerNeed(binop, needs);
+
+	if (!need || need > AVAILABLE_REGISTERS)
+		return nullptr;
+
+	auto compiled = std::make_shared<CompiledExpression>();
+	std::vector<std::uint8_t> code;
+	Assembler assembler(code);
+
+	collectVariables(binop, compiled->variables, compiled->nodes);
+	emit(assembler, binop, 0, needs, compiled->variables);
+	assembler.ret();
+
+	compiled->memory = mapExecutable(code, compiled->size);
+
+	if (!compiled->memory)
+		return nullptr;
+
+	compiled->entry = reinterpret_cast<CompiledExpression::Entry>(compiled->memory);
+
+	return compiled;
+#else
+	(void)binop;
+	return nullptr;
+#endif
+}
+
+std::shared_ptr<RuntimeValue> evaluateCompiledExpression(const BinaryExpression& binop, Environment& env)
+{
+	if (!jitEnabled())
+		return nullptr;
+
+	if (binop.evaluations.fetch_add(1, std::memory_order_relaxed) + 1 < threshold.load(std::memory_order_relaxed))
+		return nullptr;
+
+	std::call_once(binop.compileOnce, [&binop] {
+		binop.compiled = compileNumericExpression(binop);
+	});
+
+	const CompiledExpression* compiled = binop.compiled.get();
+
+	if (!compiled)
+		return nullptr;
+
+	constexpr std::size_t INLINE_SLOTS = 16;
+	double inlineSlots[INLINE_SLOTS];
+	std::vector<double> heapSlots;
+	double* slots = inlineSlots;
+
+	if (compiled->variables.size() > INLINE_SLOTS) {
+		heapSlots.resize(compiled->variables.size());
+		slots = heapSlots.data();
+	}
+
+	for (std::size_t i = 0; i < compiled->variables.size(); ++i) {
+		auto value = env.lookupVariable(compiled->variables[i]);
+
+		if (value->getType() != ValueType::Number)
+			return nullptr;
+
+		slots[i] = static_cast<const NumberValue&>(*value).value;
+	}
+
+	// The root was already charged by whoever dispatched it; the children are skipped natively.
+	consumeFuel(compiled->nodes - 1);
+
+	return MAKE_NUMBER(compiled->entry(slots));
+}
+
+namespace {
+
+std::shared_ptr<Expression> randomTree(std::mt19937& random, int depth)
+{
+	static const char* names[] = { "a", "b", "c", "d" };
+	static const char* operators[] = { "+", "-", "*", "/" };
+
+	if (depth == 0 || random() % 4 == 0) {
+		if (random() % 2) {
+			return std::make_shared<_Identifier>(names[random() % 4]);
+		}
+
+		auto literal = std::make_shared<NumericLiteral>();
+		literal->value = std::uniform_real_distribution<double>(-100.0, 100.0)(random);
+
+		if (random() % 8 == 0)
+			literal->value = 0.0;
+
+		return literal;
+	}
+
+	auto binop = std::make_shared<BinaryExpression>();
+
+	binop->_operator = operators[random() % 4];
+	binop->left = randomTree(random, depth - 1);
+	binop->right = randomTree(random, depth - 1);
+
+	return binop;
+}
+
+double referenceValue(const Expression& node, Environment& env)
+{
+	if (node.kind != NodeType::BinaryExpression)
+		return static_cast<const NumberValue&>(*evaluate(node, env)).value;
+
+	auto& binop = static_cast<const BinaryExpression&>(node);
+	NumberValue lhs(referenceValue(*binop.left, env));
+	NumberValue rhs(referenceValue(*binop.right, env));
+
+	return evaluateNumericBinaryExpression(lhs, rhs, binop._operator)->value;
+}
+
+bool sameResult(double expected, double actual)
+{
+	if (std::isnan(expected) || std::isnan(actual))
+		return std::isnan(expected) && std::isnan(actual);
+
+	return std::memcmp(&expected, &actual, sizeof(double)) == 0;
+}
+
+// The check switches the JIT on with its own threshold; the caller's settings come back afterwards.
+struct JitSettings {
+	bool wasEnabled = enabled.load();
+	std::uint32_t previousThreshold = threshold.load();
+
+	~JitSettings() {
+		enabled.store(wasEnabled);
+		threshold.store(previousThreshold);
+	}
+};
+
+// Drives evaluateCompiledExpression itself: it must leave a tree to the interpreter until the tree is
+// hot, then agree with it, and hand back to it as soon as a variable stops being a number.
+bool checkDispatch(Environment& env, std::string& failure)
+{
+	constexpr std::uint32_t hot = 3;
+
+	setJitThreshold(hot);
+
+	auto product = std::make_shared<BinaryExpression>();
+	product->_operator = "*";
+	product->left = std::make_shared<_Identifier>("a");
+	product->right = std::make_shared<_Identifier>("b");
+
+	BinaryExpression sum;
+	sum._operator = "+";
+	sum.left = product;
+	sum.right = std::make_shared<_Identifier>("c");
+
+	for (std::uint32_t i = 1; i < hot; ++i) {
+		if (evaluateCompiledExpression(sum, env)) {
+			failure = "Evaluation " + std::to_string(i) + " ran compiled code below the threshold of " + std::to_string(hot) + ".";
+			return false;
+		}
+	}
+
+	auto value = evaluateCompiledExpression(sum, env);
+	double expected = referenceValue(sum, env);
+
+	if (!value || value->getType() != ValueType::Number || !sameResult(expected, static_cast<const NumberValue&>(*value).value)) {
+		failure = "Once hot, the compiled expression did not produce " + std::to_string(expected) + ".";
+		return false;
+	}
+
+	auto previous = env.lookupVariable("c");
+	env.assignVariable("c", MAKE_STRING("text"));
+
+	bool fellBack = !evaluateCompiledExpression(sum, env);
+	std::string interpreted = formatValue(*evaluate(sum, env));
+
+	env.assignVariable("c", previous);
+
+	if (!fellBack) {
+		failure = "Compiled code ran although a variable held a string.";
+		return false;
+	}
+
+	if (interpreted != "\"" + formatNumber(referenceValue(*product, env)) + "text\"") {
+		failure = "With a string operand the interpreter produced " + interpreted + ".";
+		return false;
+	}
+
+	BinaryExpression remainder;
+	remainder._operator = "%";
+	remainder.left = std::make_shared<_Identifier>("a");
+	remainder.right = std::make_shared<_Identifier>("b");
+
+	for (std::uint32_t i = 0; i <= hot; ++i) {
+		if (evaluateCompiledExpression(remainder, env)) {
+			failure = "A tree the JIT cannot compile produced a compiled value.";
+			return false;
+		}
+	}
+
+	return true;
+}
+
+}
+
+bool jitSelfCheck(std::size_t trees, std::string& failure)
+{
+	if (!jitAvailable()) {
+		failure = "The JIT is not available on this target.";
+		return false;
+	}
+
+	std::mt19937 random(0x5eed);
+	Environment env;
+	JitSettings settings;
+
+	setJitEnabled(true);
+
+	for (const char* name : { "a", "b", "c", "d" }) {
+		env.declareVariable(name, MAKE_NUMBER(std::uniform_real_distribution<double>(-10.0, 10.0)(random)), false);
+	}
+
+	if (!checkDispatch(env, failure))
+		return false;
+
+	setJitThreshold(1);
+
+	for (std::size_t i = 0; i < trees; ++i) {
+		auto tree = randomTree(random, 1 + static_cast<int>(random() % 6));
+
+		if (tree->kind != NodeType::BinaryExpression)
+			continue;
+
+		auto& binop = static_cast<const BinaryExpression&>(*tree);
+		auto compiled = compileNumericExpression(binop);
+
+		if (!compiled)
+			continue;
+
+		std::vector<double> slots;
+
+		for (const auto& name : compiled->variables) {
+			slots.push_back(static_cast<const NumberValue&>(*env.lookupVariable(name)).value);
+		}
+
+		double expected = referenceValue(binop, env);
+		double actual = compiled->entry(slots.data());
+
+		if (!sameResult(expected, actual)) {
+			failure = "Tree " + std::to_string(i) + ": interpreter produced " + std::to_string(expected)
+				+ " but compiled code produced " + std::to_string(actual) + ".";
+			return false;
+		}
+
+		auto dispatched = evaluateCompiledExpression(binop, env);
+
+		if (!dispatched || !sameResult(expected, static_cast<const NumberValue&>(*dispatched).value)) {
+			failure = "Tree " + std::to_string(i) + ": evaluateCompiledExpression did not produce " + std::to_string(expected) + ".";
+			return false;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "ast.h"
+#include "environment.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Native code for a BinaryExpression tree built only from + - * /, numeric literals and identifiers.
+// Identifiers are resolved on every call and passed in `slots` in the order of `variables`.
+struct CompiledExpression {
+	using Entry = double (*)(const double* slots);
+
+	Entry entry = nullptr;
+	void* memory = nullptr;
+	std::size_t size = 0;
+	std::uint64_t nodes = 0;
+	std::vector<std::string> variables;
+
+	CompiledExpression() = default;
+	~CompiledExpression();
+
+	CompiledExpression(const CompiledExpression&) = delete;
+	CompiledExpression& operator = (const CompiledExpression&) = delete;
+};
+
+// True on x86-64 builds, where the JIT can emit code at all.
+bool jitAvailable();
+
+// The JIT is off by default; enabling it on an unsupported target has no effect.
+void setJitEnabled(bool enabled);
+bool jitEnabled();
+
+// Number of interpreted evaluations of a BinaryExpression before it is compiled.
+void setJitThreshold(std::uint32_t evaluations);
+
+// Returns nullptr when the tree contains anything but numeric operations or needs more registers
+// than the calling convention leaves free.
+std::shared_ptr<CompiledExpression> compileNumericExpression(const BinaryExpression& binop);
+
+// Runs the compiled form of `binop` once it is hot. Returns nullptr whenever the interpreter has to
+// take over instead: the JIT is disabled, the tree is not compilable or a variable is not a number.
+std::shared_ptr<RuntimeValue> evaluateCompiledExpression(const BinaryExpression& binop, Environment& env);
+
+// Differentially checks compiled code, called directly and through evaluateCompiledExpression, against
+// evaluateNumericBinaryExpression on random trees drawn from a fixed seed, and checks that dispatch
+// waits for the threshold and falls back on non-numeric variables. Restores the JIT settings it
+// changes. The executable runs it under --self-check.
+bool jitSelfCheck(std::size_t trees, std::string& failure);
@@ -1,4 +1,5 @@
 #include "lexer.h"
+#include "memory.h"
 
 Token createToken(const std::string& value, TokenType type)
 {
@@ -26,8 +27,10 @@ bool isInteger(char ch)
 	return std::isdigit(static_cast<unsigned char>(ch));
 }
 
-std::vector<Token> Tokenize(const std::string& sourceCode)
+std::vector<Token> Tokenize(std::string_view sourceCode)
 {
+	MemoryPhaseScope phase(MemoryPhase::Lexer);
+
 	std::vector<Token> tokens;
 	tokens.reserve(sourceCode.size() / 2);
 
@@ -90,6 +93,42 @@ std::vector<Token> Tokenize(const std::string& sourceCode)
 				tokens.push_back({ std::string(1, ch), TokenType::BinaryOperaotr});
 				++it;
 				break;
+			case '"':
+			case '\'': {
+				std::string text;
+
+				for (++it; it != end && *it != ch; ++it) {
+					if (*it != '\\') {
+						text += *it;
+						continue;
+					}
+
+					if (++it == end)
+						break;
+
+					switch (*it) {
+						case 'n': text += '\n'; break;
+						case 't': text += '\t'; break;
+						case 'r': text += '\r'; break;
+						case '0': text += '\0'; break;
+						case '\\':
+						case '"':
+						case '\'':
+							text += *it;
+							break;
+
+						default:
+							throw SyntaxError("Unknown escape sequence \\" + std::string(1, *it) + " in string literal.");
+					}
+				}
+
+				if (it == end)
+					throw SyntaxError("Unterminated string literal.");
+
+				++it;
+				tokens.push_back({ text, TokenType::String });
+				break;
+			}
 
 			default:
 				if (isInteger(ch)) {
@@ -124,14 +163,11 @@ std::vector<Token> Tokenize(const std::string& sourceCode)
 					++it;
 
 				else {
-					std::cerr << "Unrecognized character found in source: "
-						<< static_cast<int>(ch)
-						<< " ("
-						<< ch
-						<< ")"
-						<< std::endl;
-
-					exit(1);
+					throw SyntaxError("Unrecognized character found in source: "
+						+ std::to_string(static_cast<int>(ch))
+						+ " ("
+						+ std::string(1, ch)
+						+ ")");
 				}
 
 				break;
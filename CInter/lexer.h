@@ -1,7 +1,9 @@
 #pragma once
 
 #include <iostream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <cctype>
 #include <unordered_map>
@@ -25,6 +27,8 @@ enum TokenType {
 	OpenBracket,
 	CloseBracket,
 	Dot,
+	Import,
+	String,
 	_EOF,
 };
 
@@ -32,7 +36,8 @@ const std::unordered_map<std::string, TokenType> KEYWORDS {
 	{ "let", TokenType::Let },
 	{ "const", TokenType::Const },
 	{ "exostatic", TokenType::Exostatic },
-	{ "static", TokenType::Static }
+	{ "static", TokenType::Static },
+	{ "import", TokenType::Import }
 };
 
 struct Token {
@@ -40,10 +45,15 @@ struct Token {
 	TokenType type;
 };
 
+// Raised by the lexer and the parser for malformed source; the input is rejected as a whole.
+struct SyntaxError : public std::runtime_error {
+	SyntaxError(const std::string& message) : std::runtime_error(message) {}
+};
+
 Token createToken(const std::string& value, TokenType type);
 
 bool isAlphabetic(const std::string& source);
 bool isSkippable(char ch);
 bool isInteger(char ch);
 
-std::vector<Token> Tokenize(const std::string& sourceCode);
+std::vector<Token> Tokenize(std::string_view sourceCode);
@@ -1,12 +1,35 @@
 #include <iostream>
-#include "lexer.h"
-#include "parser.h"
+#include <string_view>
+#include "async.h"
+#include "self_check.h"
+#include "session.h"
 
-int main() {
-    std::string sourceCode = "let x = (5 + 10);";
+int main(int argc, char** argv) {
+    if (argc > 1 && std::string_view(argv[1]) == "--self-check")
+        return runSelfChecks(std::cout) ? 0 : 1;
 
+    auto globals = std::make_shared<Environment>();
 
-    std::cin.get();
+    declareAsyncBuiltins(*globals);
+
+    Session session(globals);
+    std::string line;
+
+    std::cout << "> " << std::flush;
+
+    while (std::getline(std::cin, line)) {
+        try {
+            SessionResult result = session.submit(line + "\n");
+
+            if (result.complete && result.value)
+                std::cout << formatValue(*result.value) << std::endl;
+        }
+        catch (const std::exception& error) {
+            std::cerr << error.what() << std::endl;
+        }
+
+        std::cout << (session.isBuffering() ? "... " : "> ") << std::flush;
+    }
 
     return 0;
 }
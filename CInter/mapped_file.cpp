@@ -0,0 +1,102 @@
+#include "mapped_file.h"
+
+#include <stdexcept>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& path)
+{
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+	if (file == INVALID_HANDLE_VALUE)
+		throw std::runtime_error("Cannot open file " + path + ".");
+
+	LARGE_INTEGER size;
+
+	if (!GetFileSizeEx(file, &size)) {
+		CloseHandle(file);
+		throw std::runtime_error("Cannot read the size of file " + path + ".");
+	}
+
+	this->file = file;
+	this->length = static_cast<std::size_t>(size.QuadPart);
+
+	// Empty files cannot be mapped; they simply have no contents.
+	if (this->length == 0)
+		return;
+
+	this->mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+	if (this->mapping)
+		this->bytes = static_cast<const char*>(MapViewOfFile(this->mapping, FILE_MAP_READ, 0, 0, 0));
+
+	if (!this->bytes) {
+		if (this->mapping)
+			CloseHandle(this->mapping);
+
+		CloseHandle(file);
+		throw std::runtime_error("Cannot map file " + path + ".");
+	}
+#else
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+	if (fd < 0)
+		throw std::runtime_error("Cannot open file " + path + ".");
+
+	struct stat status;
+
+	if (fstat(fd, &status) != 0) {
+		close(fd);
+		throw std::runtime_error("Cannot read the size of file " + path + ".");
+	}
+
+	this->length = static_cast<std::size_t>(status.st_size);
+
+	if (this->length > 0) {
+		void* mapped = mmap(nullptr, this->length, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (mapped == MAP_FAILED) {
+			close(fd);
+			throw std::runtime_error("Cannot map file " + path + ".");
+		}
+
+		this->bytes = static_cast<const char*>(mapped);
+	}
+
+	// The mapping stays valid after the descriptor is closed.
+	close(fd);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#if defined(_WIN32)
+	if (this->bytes)
+		UnmapViewOfFile(this->bytes);
+
+	if (this->mapping)
+		CloseHandle(this->mapping);
+
+	if (this->file)
+		CloseHandle(this->file);
+#else
+	if (this->bytes)
+		munmap(const_cast<char*>(this->bytes), this->length);
+#endif
+}
+
+std::string_view MappedFile::contents() const
+{
+	return this->bytes ? std::string_view(this->bytes, this->length) : std::string_view();
+}
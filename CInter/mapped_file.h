@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// A read-only view of a whole file, mapped into memory rather than copied.
+class MappedFile {
+	private:
+		const char* bytes = nullptr;
+		std::size_t length = 0;
+
+#if defined(_WIN32)
+		void* file = nullptr;
+		void* mapping = nullptr;
+#endif
+
+	public:
+		explicit MappedFile(const std::string& path);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator = (const MappedFile&) = delete;
+
+		std::string_view contents() const;
+};
@@ -0,0 +1,313 @@
+#include "memory.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <set>
+
+thread_local MemoryState currentMemoryState = { nullptr, MemoryPhase::Host };
+
+namespace {
+
+constexpr unsigned PHASE_BITS = 2;
+
+static_assert(MEMORY_PHASE_COUNT <= (1u << PHASE_BITS), "Every MemoryPhase must fit in the header's phase bits.");
+
+// Prefixed to every block handed out by operator new so frees can be refunded without a lookup.
+// The phase shares a word with the size, which keeps the header at 16 bytes.
+struct alignas(std::max_align_t) AllocationHeader {
+	MemoryContext* context;
+	std::uint64_t sizeAndPhase;
+
+	std::size_t size() const { return static_cast<std::size_t>(this->sizeAndPhase >> PHASE_BITS); }
+	MemoryPhase phase() const { return static_cast<MemoryPhase>(this->sizeAndPhase & ((1u << PHASE_BITS) - 1)); }
+};
+
+static_assert(sizeof(AllocationHeader) == 16, "The allocation header is meant to cost 16 bytes per block.");
+
+struct ContextRegistry {
+	std::mutex mutex;
+	std::set<MemoryContext*> contexts;
+};
+
+// Intentionally leaked: contexts may be released during static destruction.
+ContextRegistry& registry()
+{
+	static ContextRegistry* instance = [] {
+		MemoryScope untracked(nullptr);
+		return new ContextRegistry();
+	}();
+
+	return *instance;
+}
+
+void raisePeak(std::atomic<std::uint64_t>& peak, std::uint64_t value)
+{
+	std::uint64_t observed = peak.load(std::memory_order_relaxed);
+
+	while (observed < value && !peak.compare_exchange_weak(observed, value, std::memory_order_relaxed)) {
+	}
+}
+
+void* trackedAllocate(std::size_t size)
+{
+	MemoryState state = currentMemoryState;
+
+	if (state.context)
+		state.context->charge(size, state.phase);
+
+	void* block = std::malloc(sizeof(AllocationHeader) + size);
+
+	if (!block) {
+		if (state.context)
+			state.context->refund(size, state.phase);
+
+		return nullptr;
+	}
+
+	auto header = static_cast<AllocationHeader*>(block);
+
+	header->context = state.context;
+	header->sizeAndPhase = (std::uint64_t(size) << PHASE_BITS) | static_cast<std::uint64_t>(state.phase);
+
+	if (state.context)
+		state.context->retain();
+
+	return header + 1;
+}
+
+void trackedFree(void* pointer) noexcept
+{
+	if (!pointer)
+		return;
+
+	auto header = static_cast<AllocationHeader*>(pointer) - 1;
+	MemoryContext* context = header->context;
+
+	if (context) {
+		context->refund(header->size(), header->phase());
+		context->release();
+	}
+
+	std::free(header);
+}
+
+void* allocateOrThrow(std::size_t size)
+{
+	void* pointer = trackedAllocate(size);
+
+	if (!pointer)
+		throw std::bad_alloc();
+
+	return pointer;
+}
+
+}
+
+const char* memoryPhaseName(MemoryPhase phase)
+{
+	switch (phase) {
+		case MemoryPhase::Lexer: return "lexer";
+		case MemoryPhase::Parser: return "parser";
+		case MemoryPhase::Evaluator: return "evaluator";
+		default: return "host";
+	}
+}
+
+double allocationRate(const MemorySnapshot& earlier, const MemorySnapshot& later)
+{
+	std::uint64_t before = 0;
+	std::uint64_t after = 0;
+
+	for (std::size_t phase = 0; phase < MEMORY_PHASE_COUNT; ++phase) {
+		before += earlier.phases[phase].allocatedBytes;
+		after += later.phases[phase].allocatedBytes;
+	}
+
+	double seconds = std::chrono::duration<double>(later.takenAt - earlier.takenAt).count();
+
+	return seconds > 0.0 ? static_cast<double>(after - before) / seconds : 0.0;
+}
+
+MemoryLimitExceeded::MemoryLimitExceeded(const char* context, MemoryPhase phase, std::size_t requested, std::uint64_t limit)
+{
+	std::snprintf(message, sizeof(message), "Memory limit of %llu bytes exceeded by context '%.48s' while allocating %llu bytes in the %s.",
+		static_cast<unsigned long long>(limit), context, static_cast<unsigned long long>(requested), memoryPhaseName(phase));
+}
+
+MemoryContext::MemoryContext(std::string name, std::uint64_t limitBytes)
+	: name(std::move(name)), limitBytes(limitBytes)
+{
+}
+
+std::shared_ptr<MemoryContext> MemoryContext::create(std::string name, std::uint64_t limitBytes)
+{
+	MemoryScope untracked(nullptr);
+
+	auto context = new MemoryContext(std::move(name), limitBytes);
+
+	{
+		ContextRegistry& contexts = registry();
+		std::lock_guard<std::mutex> lock(contexts.mutex);
+
+		contexts.contexts.insert(context);
+	}
+
+	return std::shared_ptr<MemoryContext>(context, [](MemoryContext* owned) {
+		owned->release();
+	});
+}
+
+std::vector<MemorySnapshot> MemoryContext::snapshotAll()
+{
+	MemoryScope untracked(nullptr);
+	std::vector<MemorySnapshot> snapshots;
+	ContextRegistry& contexts = registry();
+	std::lock_guard<std::mutex> lock(contexts.mutex);
+
+	for (const MemoryContext* context : contexts.contexts) {
+		snapshots.push_back(context->snapshot());
+	}
+
+	return snapshots;
+}
+
+void MemoryContext::setLimit(std::uint64_t bytes)
+{
+	this->limitBytes.store(bytes, std::memory_order_relaxed);
+}
+
+MemorySnapshot MemoryContext::snapshot() const
+{
+	MemorySnapshot snapshot;
+
+	snapshot.name = this->name;
+	snapshot.takenAt = std::chrono::steady_clock::now();
+	snapshot.currentBytes = this->currentBytes.load(std::memory_order_relaxed);
+	snapshot.peakBytes = this->peakBytes.load(std::memory_order_relaxed);
+	snapshot.limitBytes = this->limitBytes.load(std::memory_order_relaxed);
+	snapshot.limitExceeded = this->limitExceeded.load(std::memory_order_relaxed);
+
+	for (std::size_t phase = 0; phase < MEMORY_PHASE_COUNT; ++phase) {
+		const PhaseCounters& counters = this->phases[phase];
+		MemoryPhaseStats& stats = snapshot.phases[phase];
+
+		stats.currentBytes = counters.currentBytes.load(std::memory_order_relaxed);
+		stats.peakBytes = counters.peakBytes.load(std::memory_order_relaxed);
+		stats.allocatedBytes = counters.allocatedBytes.load(std::memory_order_relaxed);
+		stats.allocations = counters.allocations.load(std::memory_order_relaxed);
+		stats.frees = counters.frees.load(std::memory_order_relaxed);
+	}
+
+	return snapshot;
+}
+
+void MemoryContext::charge(std::size_t bytes, MemoryPhase phase)
+{
+	std::uint64_t limit = this->limitBytes.load(std::memory_order_relaxed);
+	std::uint64_t total = this->currentBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+
+	if (limit && total > limit) {
+		this->currentBytes.fetch_sub(bytes, std::memory_order_relaxed);
+		this->limitExceeded.fetch_add(1, std::memory_order_relaxed);
+
+		throw MemoryLimitExceeded(this->name.c_str(), phase, bytes, limit);
+	}
+
+	raisePeak(this->peakBytes, total);
+
+	PhaseCounters& counters = this->phases[static_cast<std::size_t>(phase)];
+
+	raisePeak(counters.peakBytes, counters.currentBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+	counters.allocatedBytes.fetch_add(bytes, std::memory_order_relaxed);
+	counters.allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MemoryContext::refund(std::size_t bytes, MemoryPhase phase) noexcept
+{
+	PhaseCounters& counters = this->phases[static_cast<std::size_t>(phase)];
+
+	this->currentBytes.fetch_sub(bytes, std::memory_order_relaxed);
+	counters.currentBytes.fetch_sub(bytes, std::memory_order_relaxed);
+	counters.frees.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MemoryContext::retain() noexcept
+{
+	this->references.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MemoryContext::release() noexcept
+{
+	if (this->references.fetch_sub(1, std::memory_order_acq_rel) != 1)
+		return;
+
+	{
+		ContextRegistry& contexts = registry();
+		std::lock_guard<std::mutex> lock(contexts.mutex);
+
+		contexts.contexts.erase(this);
+	}
+
+	delete this;
+}
+
+void* operator new(std::size_t size)
+{
+	return allocateOrThrow(size);
+}
+
+void* operator new[](std::size_t size)
+{
+	return allocateOrThrow(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	try {
+		return trackedAllocate(size);
+	}
+	catch (...) {
+		return nullptr;
+	}
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	try {
+		return trackedAllocate(size);
+	}
+	catch (...) {
+		return nullptr;
+	}
+}
+
+void operator delete(void* pointer) noexcept
+{
+	trackedFree(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+	trackedFree(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+	trackedFree(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept
+{
+	trackedFree(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept
+{
+	trackedFree(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept
+{
+	trackedFree(pointer);
+}
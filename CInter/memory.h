@@ -0,0 +1,138 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+enum class MemoryPhase : std::uint8_t {
+	Host,
+	Lexer,
+	Parser,
+	Evaluator
+};
+
+constexpr std::size_t MEMORY_PHASE_COUNT = 4;
+
+const char* memoryPhaseName(MemoryPhase phase);
+
+struct MemoryPhaseStats {
+	std::uint64_t currentBytes = 0;
+	std::uint64_t peakBytes = 0;
+	std::uint64_t allocatedBytes = 0;
+	std::uint64_t allocations = 0;
+	std::uint64_t frees = 0;
+};
+
+struct MemorySnapshot {
+	std::string name;
+	std::chrono::steady_clock::time_point takenAt;
+	std::uint64_t currentBytes = 0;
+	std::uint64_t peakBytes = 0;
+	std::uint64_t limitBytes = 0;
+	std::uint64_t limitExceeded = 0;
+	std::array<MemoryPhaseStats, MEMORY_PHASE_COUNT> phases;
+};
+
+// Bytes per second allocated between two snapshots of the same context.
+double allocationRate(const MemorySnapshot& earlier, const MemorySnapshot& later);
+
+// Thrown by operator new when an allocation would take a context past its limit. It derives from
+// std::bad_alloc so every existing out-of-memory path unwinds the script the same way.
+class MemoryLimitExceeded : public std::bad_alloc {
+	private:
+		char message[160];
+
+	public:
+		MemoryLimitExceeded(const char* context, MemoryPhase phase, std::size_t requested, std::uint64_t limit);
+
+		const char* what() const noexcept override {
+			return message;
+		}
+};
+
+// Every allocation made while a context is installed with MemoryScope is charged to it and to the
+// current MemoryPhase, and refunded to the same context and phase when it is freed, whichever
+// thread frees it. A context stays alive until its owner and all of its allocations are gone.
+class MemoryContext {
+	private:
+		struct PhaseCounters {
+			std::atomic<std::uint64_t> currentBytes { 0 };
+			std::atomic<std::uint64_t> peakBytes { 0 };
+			std::atomic<std::uint64_t> allocatedBytes { 0 };
+			std::atomic<std::uint64_t> allocations { 0 };
+			std::atomic<std::uint64_t> frees { 0 };
+		};
+
+		std::string name;
+		std::atomic<std::uint64_t> limitBytes;
+		std::atomic<std::uint64_t> currentBytes { 0 };
+		std::atomic<std::uint64_t> peakBytes { 0 };
+		std::atomic<std::uint64_t> limitExceeded { 0 };
+		std::atomic<std::size_t> references { 1 };
+		std::array<PhaseCounters, MEMORY_PHASE_COUNT> phases;
+
+		MemoryContext(std::string name, std::uint64_t limitBytes);
+		~MemoryContext() = default;
+
+	public:
+		static std::shared_ptr<MemoryContext> create(std::string name, std::uint64_t limitBytes = 0);
+		static std::vector<MemorySnapshot> snapshotAll();
+
+		MemoryContext(const MemoryContext&) = delete;
+		MemoryContext& operator = (const MemoryContext&) = delete;
+
+		void setLimit(std::uint64_t bytes);
+		MemorySnapshot snapshot() const;
+
+		void charge(std::size_t bytes, MemoryPhase phase);
+		void refund(std::size_t bytes, MemoryPhase phase) noexcept;
+		void retain() noexcept;
+		void release() noexcept;
+};
+
+struct MemoryState {
+	MemoryContext* context;
+	MemoryPhase phase;
+};
+
+extern thread_local MemoryState currentMemoryState;
+
+class MemoryScope {
+	private:
+		MemoryState previous;
+
+	public:
+		MemoryScope(MemoryContext* context, MemoryPhase phase = MemoryPhase::Host) : previous(currentMemoryState) {
+			currentMemoryState = { context, phase };
+		}
+
+		~MemoryScope() {
+			currentMemoryState = previous;
+		}
+
+		MemoryScope(const MemoryScope&) = delete;
+		MemoryScope& operator = (const MemoryScope&) = delete;
+};
+
+class MemoryPhaseScope {
+	private:
+		MemoryPhase previous;
+
+	public:
+		MemoryPhaseScope(MemoryPhase phase) : previous(currentMemoryState.phase) {
+			currentMemoryState.phase = phase;
+		}
+
+		~MemoryPhaseScope() {
+			currentMemoryState.phase = previous;
+		}
+
+		MemoryPhaseScope(const MemoryPhaseScope&) = delete;
+		MemoryPhaseScope& operator = (const MemoryPhaseScope&) = delete;
+};
@@ -0,0 +1,409 @@
+#include "modules.h"
+#include "fuel.h"
+#include "interpreter.h"
+#include "mapped_file.h"
+#include "memory.h"
+#include "parser.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+// Modules this thread is currently evaluating, outermost first.
+thread_local std::vector<std::string> loadingModules;
+
+// Dependencies of the module this thread is evaluating; every import it performs is recorded here.
+thread_local std::vector<std::shared_ptr<const ModuleRecord>>* importedModules = nullptr;
+
+std::string joinModuleName(const std::vector<std::string>& name)
+{
+	std::string joined;
+
+	for (const auto& segment : name) {
+		if (!joined.empty())
+			joined += '.';
+
+		joined += segment;
+	}
+
+	return joined;
+}
+
+std::vector<std::string> splitModuleName(const std::string& name)
+{
+	std::vector<std::string> segments;
+	std::size_t start = 0;
+
+	for (std::size_t dot; (dot = name.find('.', start)) != std::string::npos; start = dot + 1) {
+		segments.push_back(name.substr(start, dot - start));
+	}
+
+	segments.push_back(name.substr(start));
+
+	return segments;
+}
+
+// 64-bit FNV-1a.
+std::uint64_t hashContents(std::string_view contents)
+{
+	std::uint64_t hash = 14695981039346656037ull;
+
+	for (unsigned char byte : contents) {
+		hash ^= byte;
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+}
+
+class LoadingScope {
+	private:
+		std::vector<std::shared_ptr<const ModuleRecord>>* previous;
+
+	public:
+		LoadingScope(const std::string& name, std::vector<std::shared_ptr<const ModuleRecord>>& dependencies) : previous(importedModules) {
+			loadingModules.push_back(name);
+			importedModules = &dependencies;
+		}
+
+		~LoadingScope() {
+			loadingModules.pop_back();
+			importedModules = previous;
+		}
+
+		LoadingScope(const LoadingScope&) = delete;
+		LoadingScope& operator = (const LoadingScope&) = delete;
+};
+
+}
+
+ModuleCache::ModuleCache()
+{
+}
+
+// Intentionally leaked: records may still be referenced by values destroyed during static destruction.
+ModuleCache& ModuleCache::shared()
+{
+	static ModuleCache* instance = [] {
+		MemoryScope untracked(nullptr);
+		return new ModuleCache();
+	}();
+
+	return *instance;
+}
+
+void ModuleCache::setSearchPaths(std::vector<std::filesystem::path> paths)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->searchPaths = std::move(paths);
+}
+
+void ModuleCache::setPrelude(std::shared_ptr<Environment> env)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->prelude = std::move(env);
+}
+
+std::uint64_t ModuleCache::loads() const
+{
+	return this->loadCount.load(std::memory_order_relaxed);
+}
+
+void ModuleCache::clear()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->entries.clear();
+}
+
+std::filesystem::path ModuleCache::resolve(const std::vector<std::string>& name) const
+{
+	std::vector<std::filesystem::path> roots;
+
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		roots = this->searchPaths;
+	}
+
+	if (roots.empty())
+		roots.push_back(std::filesystem::current_path());
+
+	for (const auto& root : roots) {
+		std::filesystem::path candidate = root;
+
+		for (std::size_t i = 0; i + 1 < name.size(); ++i) {
+			candidate /= name[i];
+		}
+
+		candidate /= name.back() + MODULE_EXTENSION;
+
+		std::error_code error;
+
+		if (std::filesystem::is_regular_file(candidate, error))
+			return candidate;
+	}
+
+	throw std::runtime_error("Cannot find module " + joinModuleName(name) + ".");
+}
+
+bool ModuleCache::dependenciesCurrent(const ModuleRecord& record)
+{
+	for (const auto& dependency : record.dependencies) {
+		if (this->fetch(splitModuleName(dependency->name)) != dependency)
+			return false;
+	}
+
+	return true;
+}
+
+bool ModuleCache::isCurrent(const Entry& entry)
+{
+	std::error_code error;
+	FileStamp stamp;
+
+	stamp.modified = std::filesystem::last_write_time(entry.record->path, error);
+
+	if (!error)
+		stamp.size = std::filesystem::file_size(entry.record->path, error);
+
+	if (error || !(stamp == entry.stamp))
+		return false;
+
+	return this->dependenciesCurrent(*entry.record);
+}
+
+std::shared_ptr<const ModuleRecord> ModuleCache::load(const std::vector<std::string>& name)
+{
+	if (name.empty())
+		throw std::runtime_error("Cannot import a module without a name.");
+
+	auto record = this->fetch(name);
+
+	if (importedModules)
+		importedModules->push_back(record);
+
+	return record;
+}
+
+// Called with `mutex` held. Follows the loads that the owner of `load` is itself waiting for; if
+// that chain leads back to this thread, waiting would never end.
+void ModuleCache::checkCycle(const std::string& key, const PendingLoad& load) const
+{
+	std::thread::id self = std::this_thread::get_id();
+	std::string cycle;
+
+	for (const auto& module : loadingModules) {
+		cycle += module + " -> ";
+	}
+
+	cycle += key;
+
+	for (std::thread::id owner = load.owner; owner != self;) {
+		auto waited = this->waiting.find(owner);
+
+		if (waited == this->waiting.end())
+			return;
+
+		auto next = this->pending.find(waited->second);
+
+		// That load is finishing; its waiters are about to wake up.
+		if (next == this->pending.end())
+			return;
+
+		cycle += " -> " + waited->second;
+		owner = next->second->owner;
+	}
+
+	throw std::runtime_error("Import cycle detected: " + cycle + ".");
+}
+
+std::shared_ptr<const ModuleRecord> ModuleCache::fetch(const std::vector<std::string>& name)
+{
+	std::string key = joinModuleName(name);
+	Entry cached;
+
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		auto found = this->entries.find(key);
+
+		if (found != this->entries.end())
+			cached = found->second;
+	}
+
+	if (cached.record && this->isCurrent(cached))
+		return cached.record;
+
+	std::shared_ptr<PendingLoad> load;
+	bool owner = false;
+
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		auto found = this->pending.find(key);
+
+		if (found == this->pending.end()) {
+			load = std::make_shared<PendingLoad>();
+			load->owner = std::this_thread::get_id();
+			load->result = load->promise.get_future().share();
+
+			this->pending[key] = load;
+			owner = true;
+		}
+		else {
+			load = found->second;
+
+			this->checkCycle(key, *load);
+			this->waiting[std::this_thread::get_id()] = key;
+		}
+	}
+
+	if (!owner) {
+		std::shared_ptr<const ModuleRecord> record;
+		std::string failure;
+
+		// The owner's exception is shared by every waiter, so each one throws a copy of its own.
+		try {
+			record = load->result.get();
+		}
+		catch (const std::exception& error) {
+			failure = error.what();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+			this->waiting.erase(std::this_thread::get_id());
+		}
+
+		if (!record)
+			throw std::runtime_error(failure);
+
+		return record;
+	}
+
+	try {
+		auto record = this->reload(name, key);
+
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+			this->pending.erase(key);
+		}
+
+		load->promise.set_value(record);
+
+		return record;
+	}
+	catch (const std::exception& error) {
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+			this->pending.erase(key);
+		}
+
+		// Waiters get a copy, so the exception this thread throws is never shared with another.
+		load->promise.set_exception(std::make_exception_ptr(std::runtime_error(error.what())));
+
+		throw;
+	}
+	catch (...) {
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+			this->pending.erase(key);
+		}
+
+		load->promise.set_exception(std::current_exception());
+
+		throw;
+	}
+}
+
+// Runs on the one thread that owns the pending load of `key`.
+std::shared_ptr<const ModuleRecord> ModuleCache::reload(const std::vector<std::string>& name, const std::string& key)
+{
+	Entry cached;
+	bool found = false;
+
+	// Another thread may have loaded it between the first lookup and taking ownership.
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		auto entry = this->entries.find(key);
+
+		if (entry != this->entries.end()) {
+			cached = entry->second;
+			found = true;
+		}
+	}
+
+	if (found && this->isCurrent(cached))
+		return cached.record;
+
+	std::filesystem::path path = this->resolve(name);
+	FileStamp stamp;
+
+	stamp.modified = std::filesystem::last_write_time(path);
+	stamp.size = std::filesystem::file_size(path);
+
+	MappedFile file(path.string());
+	std::uint64_t contentHash = hashContents(file.contents());
+
+	// Touched but not changed: keep the record and just remember the new stamp.
+	if (found && cached.record->path == path && cached.record->contentHash == contentHash && this->dependenciesCurrent(*cached.record)) {
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		this->entries[key].stamp = stamp;
+		return cached.record;
+	}
+
+	auto record = this->evaluateModule(key, path, contentHash, file.contents());
+
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->entries[key] = { record, stamp };
+	}
+
+	return record;
+}
+
+// Module state is shared by the whole process, so it is neither charged to the importing script's
+// memory context nor paid for out of its fuel.
+std::shared_ptr<const ModuleRecord> ModuleCache::evaluateModule(const std::string& name, const std::filesystem::path& path, std::uint64_t contentHash, std::string_view source)
+{
+	MemoryScope untracked(nullptr);
+	FuelGauge unmetered;
+	FuelScope fuel(unmetered);
+
+	auto record = std::make_shared<ModuleRecord>();
+
+	record->name = name;
+	record->path = path;
+	record->contentHash = contentHash;
+
+	std::shared_ptr<Environment> prelude;
+
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		prelude = this->prelude;
+	}
+
+	try {
+		LoadingScope scope(name, record->dependencies);
+		Parser parser;
+
+		record->program = parser.produceAST(source);
+
+		Environment env(prelude);
+		PropertyMap exports;
+
+		evaluate(*record->program, env);
+
+		env.forEachVariable([&exports](const std::string& variable, const std::shared_ptr<RuntimeValue>& value) {
+			exports = exports.set(variable, value);
+		});
+
+		record->exports = MAKE_OBJECT(std::move(exports));
+	}
+	catch (const std::exception& error) {
+		throw std::runtime_error("Failed to import module " + name + ": " + error.what());
+	}
+
+	this->loadCount.fetch_add(1, std::memory_order_relaxed);
+
+	return record;
+}
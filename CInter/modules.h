@@ -0,0 +1,100 @@
+#pragma once
+
+#include "ast.h"
+#include "environment.h"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Module sources are looked up as <search path>/a/b.cin for `import a.b;`.
+constexpr const char* MODULE_EXTENSION = ".cin";
+
+// A module after it has been parsed and evaluated. Records are immutable once published and are
+// shared by every importer on every thread; a changed source produces a new record instead.
+struct ModuleRecord {
+	std::string name;
+	std::filesystem::path path;
+	std::uint64_t contentHash = 0;
+	std::unique_ptr<Program> program;
+
+	// The module's top-level variables, bound by importers as one constant object.
+	std::shared_ptr<ObjectValue> exports;
+	std::vector<std::shared_ptr<const ModuleRecord>> dependencies;
+};
+
+// Process-wide cache of module records. A module is loaded lazily on its first import and then
+// served from the cache; every import re-checks the file's modification time and size, and a
+// change only reloads the module if its content hash changed too. A record whose dependencies were
+// reloaded is reloaded as well. Each module is loaded by one thread while other importers of it
+// wait for that load; different modules load concurrently. Import cycles are detected also when
+// the modules involved are being loaded by different threads.
+class ModuleCache {
+	private:
+		struct FileStamp {
+			std::filesystem::file_time_type modified;
+			std::uintmax_t size = 0;
+
+			bool operator == (const FileStamp& other) const {
+				return modified == other.modified && size == other.size;
+			}
+		};
+
+		struct Entry {
+			std::shared_ptr<const ModuleRecord> record;
+			FileStamp stamp;
+		};
+
+		struct PendingLoad {
+			std::thread::id owner;
+			std::promise<std::shared_ptr<const ModuleRecord>> promise;
+			std::shared_future<std::shared_ptr<const ModuleRecord>> result;
+		};
+
+		// Only the maps are guarded; no module is evaluated while `mutex` is held.
+		mutable std::mutex mutex;
+		std::map<std::string, Entry> entries;
+		std::map<std::string, std::shared_ptr<PendingLoad>> pending;
+		std::map<std::thread::id, std::string> waiting;
+		std::vector<std::filesystem::path> searchPaths;
+		std::shared_ptr<Environment> prelude;
+		std::atomic<std::uint64_t> loadCount { 0 };
+
+		std::filesystem::path resolve(const std::vector<std::string>& name) const;
+		bool isCurrent(const Entry& entry);
+		bool dependenciesCurrent(const ModuleRecord& record);
+		std::shared_ptr<const ModuleRecord> fetch(const std::vector<std::string>& name);
+		std::shared_ptr<const ModuleRecord> reload(const std::vector<std::string>& name, const std::string& key);
+		void checkCycle(const std::string& key, const PendingLoad& load) const;
+		std::shared_ptr<const ModuleRecord> evaluateModule(const std::string& name, const std::filesystem::path& path, std::uint64_t contentHash, std::string_view source);
+
+	public:
+		ModuleCache();
+
+		ModuleCache(const ModuleCache&) = delete;
+		ModuleCache& operator = (const ModuleCache&) = delete;
+
+		static ModuleCache& shared();
+
+		// Search paths are tried in order; the current directory is used when none are set.
+		void setSearchPaths(std::vector<std::filesystem::path> paths);
+
+		// Parent scope of every module's environment, e.g. for natives. It is only read while modules
+		// load, possibly from several threads, so it must not change afterwards.
+		void setPrelude(std::shared_ptr<Environment> env);
+
+		std::shared_ptr<const ModuleRecord> load(const std::vector<std::string>& name);
+
+		// Number of times a module source has been parsed and evaluated.
+		std::uint64_t loads() const;
+
+		void clear();
+};
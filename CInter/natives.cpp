@@ -0,0 +1,49 @@
+#include "natives.h"
+#include "memory.h"
+
+#include <stdexcept>
+
+// Intentionally leaked, like the natives it holds.
+NativeRegistry& NativeRegistry::shared()
+{
+	static NativeRegistry* instance = [] {
+		MemoryScope untracked(nullptr);
+		return new NativeRegistry();
+	}();
+
+	return *instance;
+}
+
+std::shared_ptr<RuntimeValue> NativeRegistry::add(const std::string& name, std::shared_ptr<RuntimeValue> native)
+{
+	ValueType type = native->getType();
+
+	if (type != ValueType::nativeFunction && type != ValueType::asyncNativeFunction)
+		throw std::invalid_argument("Only native functions can be registered, not " + name + ".");
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+	MemoryScope untracked(nullptr);
+
+	auto registered = this->natives.emplace(name, native);
+
+	if (registered.second)
+		this->names.emplace(native.get(), name);
+
+	return registered.first->second;
+}
+
+std::shared_ptr<RuntimeValue> NativeRegistry::find(const std::string& name) const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	auto found = this->natives.find(name);
+
+	return found != this->natives.end() ? found->second : nullptr;
+}
+
+std::string NativeRegistry::nameOf(const RuntimeValue& native) const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	auto found = this->names.find(&native);
+
+	return found != this->names.end() ? found->second : std::string();
+}
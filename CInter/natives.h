@@ -0,0 +1,31 @@
+#pragma once
+
+#include "values.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Natives known by a name that stays the same from one build to the next. Snapshots store a native
+// by that name and bind it back through this registry, since function pointers do not survive a
+// restart.
+class NativeRegistry {
+	private:
+		mutable std::mutex mutex;
+		std::map<std::string, std::shared_ptr<RuntimeValue>> natives;
+		std::map<const RuntimeValue*, std::string> names;
+
+	public:
+		static NativeRegistry& shared();
+
+		// Registers `native` under `name` unless the name is already taken, and returns whichever
+		// native the name is bound to, so registering on every startup is harmless.
+		std::shared_ptr<RuntimeValue> add(const std::string& name, std::shared_ptr<RuntimeValue> native);
+
+		// nullptr when nothing is registered under `name`.
+		std::shared_ptr<RuntimeValue> find(const std::string& name) const;
+
+		// Empty when `native` was never registered.
+		std::string nameOf(const RuntimeValue& native) const;
+};
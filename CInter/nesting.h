@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+// The recursive parser and evaluator spend C++ stack per nesting level, so their default
+// stays well inside a 1MB thread stack. The explicit-stack variants only spend heap.
+constexpr std::size_t DEFAULT_RECURSIVE_NESTING_LIMIT = 512;
+constexpr std::size_t DEFAULT_ITERATIVE_NESTING_LIMIT = 1 << 20;
+
+struct NestingLimitExceeded : public std::runtime_error {
+	std::size_t limit;
+
+	NestingLimitExceeded(const std::string& phase, std::size_t limit)
+		: std::runtime_error(phase + " nesting depth exceeds the limit of " + std::to_string(limit) + "."), limit(limit) {}
+};
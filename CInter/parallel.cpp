@@ -0,0 +1,299 @@
+#include "parallel.h"
+#include "dependencies.h"
+#include "fuel.h"
+#include "interpreter.h"
+#include "memory.h"
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Task {
+	const VariableDeclaration* declaration = nullptr;
+	std::vector<std::size_t> dependents;
+	std::vector<std::size_t> inputs;
+	std::atomic<std::size_t> waiting { 0 };
+
+	std::shared_ptr<RuntimeValue> value;
+	std::exception_ptr error;
+	bool skipped = false;
+	std::uint64_t fuel = 0;
+};
+
+// One run of consecutive concurrent declarations, none of which reads a name declared after it.
+class Segment {
+	private:
+		WorkStealingPool& pool;
+		Environment staging;
+		MemoryState memory;
+		std::deque<Task> tasks;
+
+		std::mutex mutex;
+		std::condition_variable finished;
+		std::size_t remaining = 0;
+
+		void schedule(std::size_t index) {
+			this->pool.submit([this, index] { this->execute(index); });
+		}
+
+		void execute(std::size_t index) {
+			Task& task = this->tasks[index];
+
+			for (std::size_t input : task.inputs) {
+				if (this->tasks[input].error || this->tasks[input].skipped)
+					task.skipped = true;
+			}
+
+			if (!task.skipped) {
+				FuelGauge gauge;
+				FuelScope fuel(gauge);
+				MemoryScope scope(this->memory.context, MemoryPhase::Evaluator);
+
+				try {
+					task.value = task.declaration->value
+						? evaluate(*task.declaration->value, this->staging)
+						: MAKE_NULL();
+
+					this->staging.redeclareVariable(task.declaration->identifier, task.value);
+				}
+				catch (...) {
+					task.error = std::current_exception();
+				}
+
+				task.fuel = gauge.consumed;
+			}
+
+			for (std::size_t dependent : task.dependents) {
+				if (this->tasks[dependent].waiting.fetch_sub(1, std::memory_order_acq_rel) == 1)
+					this->schedule(dependent);
+			}
+
+			std::lock_guard<std::mutex> lock(this->mutex);
+
+			if (--this->remaining == 0)
+				this->finished.notify_all();
+		}
+
+	public:
+		// Declarations are staged in a scope of their own and only published to `env` afterwards, in
+		// program order, so a failure leaves exactly the declarations before it. The staging scope
+		// does not own its parent; it never outlives `env`.
+		Segment(WorkStealingPool& pool, Environment& env, const std::vector<const VariableDeclaration*>& declarations, const std::vector<const std::set<std::string>*>& reads)
+			: pool(pool), staging(std::shared_ptr<Environment>(std::shared_ptr<Environment>(), &env)), memory(currentMemoryState)
+		{
+			std::map<std::string, std::size_t> positions;
+
+			for (const VariableDeclaration* declaration : declarations) {
+				Task& task = this->tasks.emplace_back();
+
+				task.declaration = declaration;
+				positions[declaration->identifier] = this->tasks.size() - 1;
+				this->staging.declareVariable(declaration->identifier, MAKE_NULL(), declaration->constant);
+			}
+
+			for (std::size_t i = 0; i < this->tasks.size(); ++i) {
+				for (const auto& name : *reads[i]) {
+					auto position = positions.find(name);
+
+					if (position == positions.end())
+						continue;
+
+					this->tasks[i].inputs.push_back(position->second);
+					this->tasks[position->second].dependents.push_back(i);
+				}
+
+				this->tasks[i].waiting.store(this->tasks[i].inputs.size(), std::memory_order_relaxed);
+			}
+
+			this->remaining = this->tasks.size();
+		}
+
+		std::shared_ptr<RuntimeValue> run(Environment& env) {
+			for (std::size_t i = 0; i < this->tasks.size(); ++i) {
+				if (this->tasks[i].inputs.empty())
+					this->schedule(i);
+			}
+
+			// Help with the work rather than only waiting for it, which also keeps a nested run on a
+			// worker thread from starving the pool.
+			for (;;) {
+				{
+					std::lock_guard<std::mutex> lock(this->mutex);
+
+					if (this->remaining == 0)
+						break;
+				}
+
+				if (!this->pool.runPending()) {
+					std::unique_lock<std::mutex> lock(this->mutex);
+
+					this->finished.wait(lock, [this] { return this->remaining == 0; });
+					break;
+				}
+			}
+
+			std::uint64_t fuel = 0;
+
+			for (const Task& task : this->tasks) {
+				fuel += task.fuel;
+			}
+
+			if (currentFuelGauge) {
+				currentFuelGauge->remaining -= static_cast<std::int64_t>(fuel);
+				currentFuelGauge->consumed += fuel;
+			}
+
+			std::shared_ptr<RuntimeValue> lastEvaluated;
+
+			for (const Task& task : this->tasks) {
+				if (task.error)
+					std::rethrow_exception(task.error);
+
+				lastEvaluated = env.declareVariable(task.declaration->identifier, task.value, task.declaration->constant);
+			}
+
+			return lastEvaluated;
+		}
+};
+
+const std::string* declaredName(const Statement& statement)
+{
+	switch (statement.kind) {
+		case NodeType::VariableDeclaration:
+			return &static_cast<const VariableDeclaration&>(statement).identifier;
+
+		case NodeType::ImportDeclaration:
+			return &static_cast<const ImportDeclaration&>(statement).binding;
+
+		default:
+			return nullptr;
+	}
+}
+
+bool isPureNative(const std::string& name, Environment& env)
+{
+	std::shared_ptr<RuntimeValue> value;
+
+	try {
+		value = env.lookupVariable(name);
+	}
+	catch (const std::runtime_error&) {
+		return false;
+	}
+
+	return value && value->getType() == ValueType::nativeFunction && static_cast<const NativeFunctionValue&>(*value).pure;
+}
+
+}
+
+std::shared_ptr<RuntimeValue> evaluateParallel(const Program& program, Environment& env, WorkStealingPool& pool)
+{
+	if (currentFuelGauge && currentFuelGauge->limit)
+		return evaluateProgram(program, env);
+
+	MemoryPhaseScope phase(MemoryPhase::Evaluator);
+
+	std::vector<StatementDependencies> analyses;
+	std::map<std::string, std::size_t> declarations;
+	std::set<std::string> rebound;
+
+	for (const auto& statement : program.body) {
+		analyses.push_back(analyzeStatement(*statement));
+
+		if (const std::string* name = declaredName(*statement)) {
+			++declarations[*name];
+			rebound.insert(*name);
+		}
+
+		rebound.insert(analyses.back().writes.begin(), analyses.back().writes.end());
+	}
+
+	// A declaration may run concurrently when all it does is compute its value from other bindings.
+	// Redeclarations and self-references keep their sequential errors by running as barriers.
+	auto concurrent = [&](std::size_t index) {
+		const Statement& statement = *program.body[index];
+		const StatementDependencies& dependencies = analyses[index];
+
+		if (statement.kind != NodeType::VariableDeclaration || !dependencies.writes.empty())
+			return false;
+
+		const std::string& name = static_cast<const VariableDeclaration&>(statement).identifier;
+
+		if (declarations[name] != 1 || dependencies.reads.count(name))
+			return false;
+
+		if (dependencies.pure)
+			return true;
+
+		if (dependencies.indirectCalls)
+			return false;
+
+		for (const auto& callee : dependencies.calls) {
+			if (rebound.count(callee) || !isPureNative(callee, env))
+				return false;
+		}
+
+		return true;
+	};
+
+	std::shared_ptr<RuntimeValue> lastEvaluated = MAKE_NULL();
+	std::vector<const VariableDeclaration*> segment;
+	std::vector<const std::set<std::string>*> segmentInputs;
+	std::set<std::string> segmentReads;
+
+	auto flush = [&]() {
+		if (segment.empty())
+			return;
+
+		bool shadowed = false;
+
+		for (const VariableDeclaration* declaration : segment) {
+			shadowed = shadowed || env.declaresVariable(declaration->identifier);
+		}
+
+		// A lone declaration gains nothing from the pool, and one that collides with an existing
+		// variable must fail exactly where the sequential run fails.
+		if (segment.size() == 1 || shadowed) {
+			for (const VariableDeclaration* declaration : segment) {
+				lastEvaluated = evaluate(*declaration, env);
+			}
+		}
+		else {
+			Segment group(pool, env, segment, segmentInputs);
+			lastEvaluated = group.run(env);
+		}
+
+		segment.clear();
+		segmentInputs.clear();
+		segmentReads.clear();
+	};
+
+	for (std::size_t i = 0; i < program.body.size(); ++i) {
+		if (!concurrent(i)) {
+			flush();
+			lastEvaluated = evaluate(*program.body[i], env);
+			continue;
+		}
+
+		auto& declaration = static_cast<const VariableDeclaration&>(*program.body[i]);
+
+		// An earlier declaration of this segment refers to this name before it exists.
+		if (segmentReads.count(declaration.identifier))
+			flush();
+
+		segment.push_back(&declaration);
+		segmentInputs.push_back(&analyses[i].reads);
+		segmentReads.insert(analyses[i].reads.begin(), analyses[i].reads.end());
+	}
+
+	flush();
+
+	return lastEvaluated;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "ast.h"
+#include "environment.h"
+#include "thread_pool.h"
+
+#include <memory>
+
+// Evaluates `program` like evaluateProgram, but runs top-level declarations that do not read each
+// other's bindings concurrently on `pool`. Only declarations without assignments and without calls,
+// other than calls to natives marked pure, take part; every other statement is a barrier that runs
+// alone, after everything before it and before anything after it. The environment ends up exactly
+// as the sequential run leaves it, and a failing statement throws the error the sequential run would.
+// Runs with a fuel limit are evaluated sequentially, so the limit trips at the same statement.
+std::shared_ptr<RuntimeValue> evaluateParallel(const Program& program, Environment& env, WorkStealingPool& pool = WorkStealingPool::shared());
@@ -1,20 +1,25 @@
 #include "parser.h"
+#include "memory.h"
+#include "values.h"
 
 bool Parser::not_EOF() const
 {
-    return !tokens.empty() && tokens.front().type != TokenType::_EOF;
+    return this->position < tokens.size() && tokens[this->position].type != TokenType::_EOF;
 }
 
-Token Parser::at() const
+const Token& Parser::at() const
 {
-    return tokens.empty() ? Token{} : tokens.front();
+    static const Token endOfFile { "EndOfFile", TokenType::_EOF };
+
+    return this->position < tokens.size() ? tokens[this->position] : endOfFile;
 }
 
 Token Parser::eat()
 {
-    Token previous = std::move(tokens.front());
+    Token previous = this->at();
 
-    tokens.erase(tokens.begin());
+    if (this->position < tokens.size())
+        ++this->position;
 
     return previous;
 }
@@ -24,8 +29,7 @@ Token Parser::expect(TokenType type, const std::string& err)
     Token previous = eat();
 
     if (previous.type != type) {
-        std::cerr << "Parser Error:\n" << err << " - Expecting: " << static_cast<int>(type) << std::endl;
-        exit(1);
+        throw SyntaxError("Parser Error: " + err + " - Expecting: " + std::to_string(static_cast<int>(type)));
     }
 
     return previous;
@@ -38,6 +42,9 @@ std::unique_ptr<Statement> Parser::parseStatement()
     case TokenType::Let:
         return this->parseVariableDeclaration();
 
+    case TokenType::Import:
+        return this->parseImportDeclaration();
+
     default: 
         auto expression = this->parseExpression();
         
@@ -58,7 +65,7 @@ std::unique_ptr<Statement> Parser::parseVariableDeclaration()
         this->eat();
         
         if (isConstant)
-            throw "Must assign value to constant expression. No value provided.";
+            throw SyntaxError("Must assign value to constant expression. No value provided.");
 
         auto varDeclaration = std::make_unique<VariableDeclaration>();
         
@@ -76,17 +83,54 @@ std::unique_ptr<Statement> Parser::parseVariableDeclaration()
     declaration->constant = isConstant;
     declaration->kind = NodeType::VariableDeclaration;
     declaration->value = this->parseExpression();
+
+    if (this->at().type == TokenType::Semicolon)
+        this->eat();
     
     return declaration;
 }
 
+std::unique_ptr<Statement> Parser::parseImportDeclaration()
+{
+    this->eat();
+
+    auto declaration = std::make_unique<ImportDeclaration>();
+
+    declaration->path.push_back(this->expect(TokenType::Identifier, "Expected module name following import keyword.").value);
+
+    while (this->at().type == TokenType::Dot) {
+        this->eat();
+        declaration->path.push_back(this->expect(TokenType::Identifier, "Expected module name following '.' in import.").value);
+    }
+
+    declaration->binding = declaration->path.back();
+
+    if (this->at().type == TokenType::Identifier && this->at().value == "as") {
+        this->eat();
+        declaration->binding = this->expect(TokenType::Identifier, "Expected binding name following 'as' in import.").value;
+    }
+
+    if (this->at().type == TokenType::Semicolon)
+        this->eat();
+
+    return declaration;
+}
+
 std::unique_ptr<Expression> Parser::parseExpression()
 {
+    if (this->options.iterative)
+        return this->parseExpressionIterative();
+
     return this->parseAssignmentExpression();
 }
 
 std::unique_ptr<Expression> Parser::parseAssignmentExpression()
 {
+    if (this->depth >= this->options.maxDepth)
+        throw NestingLimitExceeded("Parser", this->options.maxDepth);
+
+    ++this->depth;
+
     auto left = this->parseObjectExpression();
 
     if (this->at().type == TokenType::Equals) {
@@ -100,9 +144,11 @@ std::unique_ptr<Expression> Parser::parseAssignmentExpression()
         assignment->assignee = std::move(left);
         assignment->kind = NodeType::AssignmentExpression;
         
+        --this->depth;
         return assignment;
     }
 
+    --this->depth;
     return left;
 }
 
@@ -125,6 +171,7 @@ std::unique_ptr<Expression> Parser::parseObjectExpression()
             auto prop = std::make_unique<Property>();
             
             prop->key = key;
+            prop->internedKey = internString(key);
             prop->kind = NodeType::Property;
             
             properties.push_back(std::move(prop));
@@ -138,6 +185,7 @@ std::unique_ptr<Expression> Parser::parseObjectExpression()
         auto prop = std::make_unique<Property>();
         
         prop->key = key;
+        prop->internedKey = internString(key);
         prop->kind = NodeType::Property;
         prop->value = std::move(value);
         
@@ -160,9 +208,9 @@ std::unique_ptr<Expression> Parser::parseObjectExpression()
 
 std::unique_ptr<Expression> Parser::parseAdditiveExpression()
 {
-    auto left = this->parseMultiplicativeExpression();
+    std::unique_ptr<Expression> left = this->parseMultiplicativeExpression();
 
-    while (this->at().value == "+" || this->at().value == "-") {
+    while (this->at().type == TokenType::BinaryOperaotr && (this->at().value == "+" || this->at().value == "-")) {
         std::string _operator = this->eat().value;
         
         auto right = this->parseMultiplicativeExpression();
@@ -171,8 +219,9 @@ std::unique_ptr<Expression> Parser::parseAdditiveExpression()
         binaryExpr->kind = NodeType::BinaryExpression;
         binaryExpr->left = std::move(left);
         binaryExpr->right = std::move(right);
+        binaryExpr->_operator = _operator;
         
-        return binaryExpr;
+        left = std::move(binaryExpr);
     }
 
     return left;
@@ -180,9 +229,9 @@ std::unique_ptr<Expression> Parser::parseAdditiveExpression()
 
 std::unique_ptr<Expression> Parser::parseMultiplicativeExpression()
 {
-    auto left = this->parseCallMemberExpression();
+    std::unique_ptr<Expression> left = this->parseCallMemberExpression();
 
-    while (this->at().value == "/" || this->at().value == "*" || this->at().value == "%") {
+    while (this->at().type == TokenType::BinaryOperaotr && (this->at().value == "/" || this->at().value == "*" || this->at().value == "%")) {
         std::string _operator = this->eat().value;
         
         auto right = this->parseCallMemberExpression();
@@ -191,8 +240,9 @@ std::unique_ptr<Expression> Parser::parseMultiplicativeExpression()
         binaryExpr->kind = NodeType::BinaryExpression;
         binaryExpr->left = std::move(left);
         binaryExpr->right = std::move(right);
+        binaryExpr->_operator = _operator;
         
-        return binaryExpr;
+        left = std::move(binaryExpr);
     }
 
     return left;
@@ -211,17 +261,17 @@ std::unique_ptr<Expression> Parser::parseCallMemberExpression()
 
 std::unique_ptr<Expression> Parser::parseCallExpression(std::unique_ptr<Expression> caller)
 {
-    auto callExpression = std::make_unique<CallExpression>();
-    
-    callExpression->kind = NodeType::CallExpression;
-    callExpression->caller = std::move(caller);
-    callExpression->args = std::move(this->parseArgs()); 
+    do {
+        auto callExpression = std::make_unique<CallExpression>();
+        
+        callExpression->kind = NodeType::CallExpression;
+        callExpression->caller = std::move(caller);
+        callExpression->args = this->parseArgs(); 
 
-    if (this->at().type == TokenType::OpenParen) {
-        return this->parseCallExpression(std::move(callExpression));
-    }
+        caller = std::move(callExpression);
+    } while (this->at().type == TokenType::OpenParen);
 
-    return callExpression;
+    return caller;
 }
 
 
@@ -270,7 +320,7 @@ std::unique_ptr<Expression> Parser::parseMemberExpression()
             property = this->parsePrimaryExpression();
 
             if (property->kind != NodeType::Identifier) {
-                throw "Cannot use a dot operator without right hand side being an identifier";
+                throw SyntaxError("Cannot use a dot operator without right hand side being an identifier");
             }
         }
         else {
@@ -286,6 +336,9 @@ std::unique_ptr<Expression> Parser::parseMemberExpression()
         memberExpression->object = std::move(object);
         memberExpression->property = std::move(property);
         memberExpression->computed = computed;
+
+        if (!computed)
+            memberExpression->internedKey = internString(static_cast<const _Identifier&>(*memberExpression->property).symbol);
     
         object = std::move(memberExpression);
     }
@@ -300,8 +353,20 @@ std::unique_ptr<Expression> Parser::parsePrimaryExpression()
     switch (token) {
         case TokenType::Identifier: 
             return std::make_unique<_Identifier>(this->eat().value);
-        case TokenType::Number:
-            return std::make_unique<NumericLiteral>(this->eat().value);
+        case TokenType::Number: {
+            auto numericLiteral = std::make_unique<NumericLiteral>();
+
+            numericLiteral->value = std::stod(this->eat().value);
+
+            return numericLiteral;
+        }
+        case TokenType::String: {
+            auto stringLiteral = std::make_unique<StringLiteral>();
+
+            stringLiteral->value = internString(this->eat().value);
+
+            return stringLiteral;
+        }
         case TokenType::OpenParen: {
             this->eat();
 
@@ -313,19 +378,428 @@ std::unique_ptr<Expression> Parser::parsePrimaryExpression()
         }
 
         default: {
-            std::cerr << "Unexpected token found during parsing! " << this->at().value << std::endl;
-            std::exit(1);
+            throw SyntaxError("Unexpected token found during parsing! " + this->at().value);
         }
     }
 }
 
-std::unique_ptr<Program> Parser::produceAST(std::string& sourceCode)
+namespace {
+
+enum class PendingKind {
+    Binary,
+    Assignment,
+    Paren,
+    Call,
+    Computed,
+    Object
+};
+
+struct Pending {
+    PendingKind kind;
+    std::string _operator;
+    std::size_t operandBase = 0;
+    std::vector<std::unique_ptr<Property>> properties;
+    std::string key;
+};
+
+int precedence(const std::string& _operator)
 {
+    return _operator == "+" || _operator == "-" ? 1 : 2;
+}
+
+bool isGroup(PendingKind kind)
+{
+    return kind != PendingKind::Binary && kind != PendingKind::Assignment;
+}
+
+// What may still extend the operand just completed. The recursive chain applies member access
+// and calls to a primary, only further calls to a call, and hands an object literal straight
+// back to parseAssignmentExpression, where nothing but '=' can follow it.
+enum class Suffix {
+    MemberOrCall,
+    Call,
+    None
+};
+
+}
+
+// Mirrors the parseAssignmentExpression chain, but keeps every open operator, parenthesis,
+// call, computed member and object literal on heap stacks so nesting costs no C++ stack.
+// Both parsers accept exactly the same programs; --self-check compares them on a corpus.
+std::unique_ptr<Expression> Parser::parseExpressionIterative()
+{
+    std::vector<std::unique_ptr<Expression>> operands;
+    std::vector<Pending> pending;
+    bool expectOperand = true;
+
+    // Object literals start an assignment expression, so none may follow a binary operator.
+    bool objectAllowed = true;
+    Suffix suffix = Suffix::MemberOrCall;
+
+    auto open = [&](PendingKind kind) -> Pending& {
+        if (pending.size() >= this->options.maxDepth)
+            throw NestingLimitExceeded("Parser", this->options.maxDepth);
+
+        Pending entry;
+        entry.kind = kind;
+        entry.operandBase = operands.size();
+        pending.push_back(std::move(entry));
+
+        return pending.back();
+    };
+
+    auto pop = [&]() {
+        auto operand = std::move(operands.back());
+        operands.pop_back();
+        return operand;
+    };
+
+    auto reduce = [&]() {
+        Pending entry = std::move(pending.back());
+        pending.pop_back();
+
+        auto right = pop();
+        auto left = pop();
+
+        if (entry.kind == PendingKind::Assignment) {
+            auto assignment = std::make_unique<AssignmentExpression>();
+
+            assignment->assignee = std::move(left);
+            assignment->value = std::move(right);
+            operands.push_back(std::move(assignment));
+            return;
+        }
+
+        auto binaryExpr = std::make_unique<BinaryExpression>();
+
+        binaryExpr->left = std::move(left);
+        binaryExpr->right = std::move(right);
+        binaryExpr->_operator = entry._operator;
+        operands.push_back(std::move(binaryExpr));
+    };
+
+    auto reduceToGroup = [&]() {
+        while (!pending.empty() && !isGroup(pending.back().kind))
+            reduce();
+    };
+
+    auto fail = [&](const std::string& err) {
+        throw SyntaxError("Parser Error: " + err + " - Found: " + this->at().value);
+    };
+
+    // Only meaningful after reduceToGroup(): nullptr once no group is left open.
+    auto innermostGroup = [&]() -> Pending* {
+        return pending.empty() ? nullptr : &pending.back();
+    };
+
+    // Reads the next `key`, `key,` or `key:` inside an object literal. Returns false once a
+    // value has to be parsed for the key, true when the literal was closed instead.
+    auto beginProperty = [&]() -> bool {
+        for (;;) {
+            if (this->at().type == TokenType::CloseBrace) {
+                this->eat();
+
+                Pending entry = std::move(pending.back());
+                pending.pop_back();
+
+                auto object = std::make_unique<ObjectLiteral>();
+                object->properties = std::move(entry.properties);
+                operands.push_back(std::move(object));
+                suffix = Suffix::None;
+
+                return true;
+            }
+
+            std::string key = this->expect(TokenType::Identifier, "Object literal key expected").value;
+
+            if (this->at().type == TokenType::Comma) {
+                this->eat();
+
+                auto prop = std::make_unique<Property>();
+                prop->key = key;
+                prop->internedKey = internString(key);
+                pending.back().properties.push_back(std::move(prop));
+
+                continue;
+            }
+
+            this->expect(TokenType::Colon, "Missing colon following identifier in ObjectExpression");
+            pending.back().key = key;
+            objectAllowed = true;
+
+            return false;
+        }
+    };
+
+    auto finishProperty = [&]() {
+        auto prop = std::make_unique<Property>();
+
+        prop->key = pending.back().key;
+        prop->internedKey = internString(prop->key);
+        prop->value = pop();
+        pending.back().properties.push_back(std::move(prop));
+    };
+
+    for (;;) {
+        if (expectOperand) {
+            if (this->at().type != TokenType::OpenBrace)
+                suffix = Suffix::MemberOrCall;
+
+            switch (this->at().type) {
+                case TokenType::Identifier:
+                    operands.push_back(std::make_unique<_Identifier>(this->eat().value));
+                    expectOperand = false;
+                    break;
+
+                case TokenType::Number: {
+                    auto numericLiteral = std::make_unique<NumericLiteral>();
+
+                    numericLiteral->value = std::stod(this->eat().value);
+                    operands.push_back(std::move(numericLiteral));
+                    expectOperand = false;
+                    break;
+                }
+
+                case TokenType::String: {
+                    auto stringLiteral = std::make_unique<StringLiteral>();
+
+                    stringLiteral->value = internString(this->eat().value);
+                    operands.push_back(std::move(stringLiteral));
+                    expectOperand = false;
+                    break;
+                }
+
+                case TokenType::OpenParen:
+                    this->eat();
+                    open(PendingKind::Paren);
+                    objectAllowed = true;
+                    break;
+
+                case TokenType::OpenBrace:
+                    if (!objectAllowed)
+                        throw SyntaxError("Unexpected token found during parsing! " + this->at().value);
+
+                    this->eat();
+                    open(PendingKind::Object);
+                    expectOperand = !beginProperty();
+                    break;
+
+                default:
+                    throw SyntaxError("Unexpected token found during parsing! " + this->at().value);
+            }
+
+            continue;
+        }
+
+        Pending* group = nullptr;
+        TokenType type = this->at().type;
+
+        // A token that cannot extend this operand ends the expression, as it would end the
+        // recursive chain.
+        if (((type == TokenType::Dot || type == TokenType::OpenBracket) && suffix != Suffix::MemberOrCall)
+            || ((type == TokenType::OpenParen || type == TokenType::BinaryOperaotr) && suffix == Suffix::None))
+            type = TokenType::_EOF;
+
+        switch (type) {
+            case TokenType::Dot: {
+                this->eat();
+
+                // parseMemberExpression reads the property as a primary expression, so an identifier
+                // may sit inside any number of parentheses.
+                std::size_t parentheses = 0;
+
+                while (this->at().type == TokenType::OpenParen) {
+                    this->eat();
+                    ++parentheses;
+                }
+
+                auto memberExpression = std::make_unique<MemberExpression>(false);
+
+                memberExpression->object = pop();
+                memberExpression->property = std::make_unique<_Identifier>(
+                    this->expect(TokenType::Identifier, "Cannot use a dot operator without right hand side being an identifier").value
+                );
+                memberExpression->internedKey = internString(static_cast<const _Identifier&>(*memberExpression->property).symbol);
+                operands.push_back(std::move(memberExpression));
+
+                while (parentheses-- > 0)
+                    this->expect(TokenType::CloseParen, "Unexpected token found isnide parenthesised expression. Expected closing parenthessis.");
+
+                continue;
+            }
+
+            case TokenType::OpenBracket:
+                this->eat();
+                open(PendingKind::Computed);
+                expectOperand = true;
+                objectAllowed = true;
+                continue;
+
+            case TokenType::OpenParen:
+                this->eat();
+                open(PendingKind::Call);
+
+                if (this->at().type != TokenType::CloseParen) {
+                    expectOperand = true;
+                    objectAllowed = true;
+                    continue;
+                }
+
+                break;
+
+            case TokenType::BinaryOperaotr: {
+                std::string _operator = this->eat().value;
+
+                while (!pending.empty() && pending.back().kind == PendingKind::Binary && precedence(pending.back()._operator) >= precedence(_operator))
+                    reduce();
+
+                open(PendingKind::Binary)._operator = _operator;
+                expectOperand = true;
+                objectAllowed = false;
+                continue;
+            }
+
+            case TokenType::Equals:
+                this->eat();
+
+                while (!pending.empty() && pending.back().kind == PendingKind::Binary)
+                    reduce();
+
+                open(PendingKind::Assignment);
+                expectOperand = true;
+                objectAllowed = true;
+                continue;
+
+            case TokenType::Comma:
+                reduceToGroup();
+                group = innermostGroup();
+
+                if (!group)
+                    break;
+
+                if (group->kind == PendingKind::Call) {
+                    this->eat();
+                    expectOperand = true;
+                    objectAllowed = true;
+                    continue;
+                }
+
+                if (group->kind == PendingKind::Object) {
+                    this->eat();
+                    finishProperty();
+                    expectOperand = !beginProperty();
+                    continue;
+                }
+
+                fail("Unexpected comma found inside expression.");
+                break;
+
+            case TokenType::CloseBrace:
+                reduceToGroup();
+                group = innermostGroup();
+
+                if (!group)
+                    break;
+
+                if (group->kind != PendingKind::Object)
+                    fail("Unexpected closing brace found inside expression.");
+
+                finishProperty();
+                beginProperty();
+                continue;
+
+            case TokenType::CloseBracket:
+                reduceToGroup();
+                group = innermostGroup();
+
+                if (!group)
+                    break;
+
+                if (group->kind != PendingKind::Computed)
+                    fail("Unexpected closing bracket found inside expression.");
+
+                this->eat();
+                pending.pop_back();
+
+                {
+                    auto memberExpression = std::make_unique<MemberExpression>(true);
+
+                    memberExpression->property = pop();
+                    memberExpression->object = pop();
+                    operands.push_back(std::move(memberExpression));
+                }
+
+                suffix = Suffix::MemberOrCall;
+                continue;
+
+            case TokenType::CloseParen:
+                reduceToGroup();
+                group = innermostGroup();
+
+                if (!group)
+                    break;
+
+                if (group->kind == PendingKind::Paren) {
+                    this->eat();
+                    pending.pop_back();
+                    suffix = Suffix::MemberOrCall;
+                    continue;
+                }
+
+                if (group->kind != PendingKind::Call)
+                    fail("Unexpected closing parenthesis found inside expression.");
+
+                break;
+
+            default:
+                break;
+        }
+
+        // Either a call's closing parenthesis or the end of the expression.
+        group = innermostGroup();
+
+        if (this->at().type == TokenType::CloseParen && group) {
+            reduceToGroup();
+            group = innermostGroup();
+        }
+
+        if (group && group->kind == PendingKind::Call && this->at().type == TokenType::CloseParen) {
+            this->eat();
+
+            Pending entry = std::move(pending.back());
+            pending.pop_back();
+
+            auto callExpression = std::make_unique<CallExpression>();
+
+            for (std::size_t i = entry.operandBase; i < operands.size(); ++i)
+                callExpression->args.push_back(std::move(operands[i]));
+
+            operands.resize(entry.operandBase);
+            callExpression->caller = pop();
+            operands.push_back(std::move(callExpression));
+            suffix = Suffix::Call;
+            continue;
+        }
+
+        reduceToGroup();
+
+        if (!pending.empty())
+            fail("Unterminated expression.");
+
+        return pop();
+    }
+}
+
+std::unique_ptr<Program> Parser::produceAST(std::string_view sourceCode)
+{
+    MemoryPhaseScope phase(MemoryPhase::Parser);
+
     this->tokens = Tokenize(sourceCode);
+    this->position = 0;
+    this->depth = 0;
 
     auto program = std::make_unique<Program>();
     
-    program->body = {};
     program->kind = NodeType::Program;
 
     while (this->not_EOF()) {
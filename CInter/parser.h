@@ -2,19 +2,31 @@
 
 #include "lexer.h"
 #include "ast.h"
+#include "nesting.h"
+
+// `iterative` parses expressions with a heap-allocated operator stack instead of recursive descent.
+// A `maxDepth` of zero selects the default limit of the chosen mode.
+struct ParserOptions {
+	bool iterative = false;
+	std::size_t maxDepth = 0;
+};
 
 class Parser {
 	private:
 		std::vector<Token> tokens = {};
+		std::size_t position = 0;
+		std::size_t depth = 0;
+		ParserOptions options;
 
 		bool not_EOF() const;
 
-		Token at() const;
+		const Token& at() const;
 		Token eat();
 		Token expect(TokenType type, const std::string& err);
 
 		std::unique_ptr<Statement> parseStatement();
 		std::unique_ptr<Statement> parseVariableDeclaration();
+		std::unique_ptr<Statement> parseImportDeclaration();
 		std::unique_ptr<Expression> parseExpression();
 		std::unique_ptr<Expression> parseAssignmentExpression();
 		std::unique_ptr<Expression> parseObjectExpression();
@@ -25,8 +37,14 @@ class Parser {
 		std::vector<std::unique_ptr<Expression>> parseArgs();
 		std::vector<std::unique_ptr<Expression>> parseArgsList();
 		std::unique_ptr<Expression>	parseMemberExpression();
-		std::unique_ptr<Expression> parsePrimaryExpression();;
+		std::unique_ptr<Expression> parsePrimaryExpression();
+		std::unique_ptr<Expression> parseExpressionIterative();
 	
 	public:
-		std::unique_ptr<Program> produceAST(std::string& sourceCode);
+		Parser(ParserOptions options = {}) : options(options) {
+			if (!this->options.maxDepth)
+				this->options.maxDepth = options.iterative ? DEFAULT_ITERATIVE_NESTING_LIMIT : DEFAULT_RECURSIVE_NESTING_LIMIT;
+		}
+
+		std::unique_ptr<Program> produceAST(std::string_view sourceCode);
 };
\ No newline at end of file
@@ -0,0 +1,364 @@
+#include "properties.h"
+#include "memory.h"
+
+#include <algorithm>
+#include <bitset>
+#include <climits>
+
+namespace {
+
+constexpr unsigned BITS_PER_LEVEL = 5;
+constexpr std::size_t LEVEL_MASK = (1u << BITS_PER_LEVEL) - 1;
+constexpr unsigned HASH_BITS = sizeof(std::size_t) * CHAR_BIT;
+
+unsigned slotIndex(std::uint32_t bitmap, std::uint32_t bit)
+{
+	return static_cast<unsigned>(std::bitset<32>(bitmap & (bit - 1)).count());
+}
+
+}
+
+// A node is either bitmap-indexed, with one slot per set bit holding a leaf or a child, or,
+// once every hash bit has been consumed, a collision node whose slots are all leaves.
+struct PropertyMap::Node {
+	struct Slot {
+		std::shared_ptr<const Node> child;
+		std::size_t hash = 0;
+		std::string key;
+		Value value;
+	};
+
+	std::uint32_t bitmap = 0;
+	bool collision = false;
+	std::vector<Slot> slots;
+
+	Node() = default;
+	Node(const Node&) = default;
+	~Node();
+};
+
+namespace {
+
+using Node = PropertyMap::Node;
+using Slot = Node::Slot;
+using NodePtr = std::shared_ptr<const Node>;
+
+thread_local std::vector<NodePtr> releasedNodes;
+thread_local std::vector<PropertyMap::Value> releasedValues;
+thread_local bool releasing = false;
+
+// Objects can nest as deep as a script builds them, and releasing the outermost one would release
+// every level below it recursively. Nodes and values are queued instead and dropped one at a time.
+template <typename Pointer>
+void deferRelease(std::vector<Pointer>& released, Pointer pointer) noexcept
+{
+	if (!pointer)
+		return;
+
+	try {
+		MemoryScope untracked(nullptr);
+		released.push_back(std::move(pointer));
+	}
+	catch (...) {
+		pointer.reset();
+	}
+}
+
+void drainReleased() noexcept
+{
+	if (releasing)
+		return;
+
+	releasing = true;
+
+	while (!releasedNodes.empty() || !releasedValues.empty()) {
+		if (!releasedValues.empty()) {
+			auto value = std::move(releasedValues.back());
+			releasedValues.pop_back();
+		}
+		else {
+			auto node = std::move(releasedNodes.back());
+			releasedNodes.pop_back();
+		}
+	}
+
+	releasing = false;
+}
+
+NodePtr mergeLeaves(Slot first, Slot second, unsigned shift)
+{
+	auto node = std::make_shared<Node>();
+
+	if (shift >= HASH_BITS) {
+		node->collision = true;
+		node->slots.push_back(std::move(first));
+		node->slots.push_back(std::move(second));
+
+		return node;
+	}
+
+	std::size_t firstIndex = (first.hash >> shift) & LEVEL_MASK;
+	std::size_t secondIndex = (second.hash >> shift) & LEVEL_MASK;
+
+	if (firstIndex == secondIndex) {
+		Slot slot;
+		slot.child = mergeLeaves(std::move(first), std::move(second), shift + BITS_PER_LEVEL);
+
+		node->bitmap = 1u << firstIndex;
+		node->slots.push_back(std::move(slot));
+
+		return node;
+	}
+
+	node->bitmap = (1u << firstIndex) | (1u << secondIndex);
+
+	if (firstIndex < secondIndex) {
+		node->slots.push_back(std::move(first));
+		node->slots.push_back(std::move(second));
+	}
+	else {
+		node->slots.push_back(std::move(second));
+		node->slots.push_back(std::move(first));
+	}
+
+	return node;
+}
+
+NodePtr insert(const NodePtr& node, Slot leaf, unsigned shift, bool& added)
+{
+	if (!node) {
+		added = true;
+
+		auto created = std::make_shared<Node>();
+		created->bitmap = 1u << ((leaf.hash >> shift) & LEVEL_MASK);
+		created->slots.push_back(std::move(leaf));
+
+		return created;
+	}
+
+	auto copy = std::make_shared<Node>(*node);
+
+	if (node->collision) {
+		for (auto& slot : copy->slots) {
+			if (slot.key == leaf.key) {
+				slot.value = std::move(leaf.value);
+				return copy;
+			}
+		}
+
+		added = true;
+		copy->slots.push_back(std::move(leaf));
+
+		return copy;
+	}
+
+	std::uint32_t bit = 1u << ((leaf.hash >> shift) & LEVEL_MASK);
+	unsigned index = slotIndex(node->bitmap, bit);
+
+	if (!(node->bitmap & bit)) {
+		added = true;
+		copy->bitmap |= bit;
+		copy->slots.insert(copy->slots.begin() + index, std::move(leaf));
+
+		return copy;
+	}
+
+	Slot& slot = copy->slots[index];
+
+	if (slot.child) {
+		slot.child = insert(slot.child, std::move(leaf), shift + BITS_PER_LEVEL, added);
+	}
+	else if (slot.hash == leaf.hash && slot.key == leaf.key) {
+		slot.value = std::move(leaf.value);
+	}
+	else {
+		added = true;
+
+		Slot existing = std::move(slot);
+		slot = Slot();
+		slot.child = mergeLeaves(std::move(existing), std::move(leaf), shift + BITS_PER_LEVEL);
+	}
+
+	return copy;
+}
+
+// Returns `node` itself when the key is absent and nullptr once a node becomes empty.
+NodePtr remove(const NodePtr& node, std::size_t hash, const std::string& key, unsigned shift, bool& removed)
+{
+	if (node->collision) {
+		auto match = std::find_if(node->slots.begin(), node->slots.end(), [&](const Slot& slot) {
+			return slot.key == key;
+		});
+
+		if (match == node->slots.end())
+			return node;
+
+		removed = true;
+
+		if (node->slots.size() == 1)
+			return nullptr;
+
+		auto copy = std::make_shared<Node>(*node);
+		copy->slots.erase(copy->slots.begin() + (match - node->slots.begin()));
+
+		return copy;
+	}
+
+	std::uint32_t bit = 1u << ((hash >> shift) & LEVEL_MASK);
+
+	if (!(node->bitmap & bit))
+		return node;
+
+	unsigned index = slotIndex(node->bitmap, bit);
+	const Slot& slot = node->slots[index];
+	NodePtr replacement;
+
+	if (slot.child) {
+		replacement = remove(slot.child, hash, key, shift + BITS_PER_LEVEL, removed);
+
+		if (replacement == slot.child)
+			return node;
+	}
+	else if (slot.hash != hash || slot.key != key) {
+		return node;
+	}
+	else {
+		removed = true;
+	}
+
+	auto copy = std::make_shared<Node>(*node);
+
+	// A child left holding a single leaf is folded back into this node to keep the trie canonical.
+	if (replacement && replacement->slots.size() == 1 && !replacement->slots.front().child) {
+		copy->slots[index] = replacement->slots.front();
+		return copy;
+	}
+
+	if (replacement) {
+		copy->slots[index].child = std::move(replacement);
+		return copy;
+	}
+
+	copy->bitmap &= ~bit;
+	copy->slots.erase(copy->slots.begin() + index);
+
+	if (copy->slots.empty())
+		return nullptr;
+
+	return copy;
+}
+
+void visit(const Node& node, const std::function<void(const std::string&, const PropertyMap::Value&)>& callback)
+{
+	for (const auto& slot : node.slots) {
+		if (slot.child)
+			visit(*slot.child, callback);
+
+		else
+			callback(slot.key, slot.value);
+	}
+}
+
+}
+
+PropertyMap::Node::~Node()
+{
+	for (auto& slot : this->slots) {
+		deferRelease(releasedNodes, std::move(slot.child));
+		deferRelease(releasedValues, std::move(slot.value));
+	}
+
+	drainReleased();
+}
+
+PropertyMap::~PropertyMap()
+{
+	deferRelease(releasedNodes, std::move(this->root));
+	drainReleased();
+}
+
+std::size_t PropertyMap::hashKey(std::string_view key)
+{
+	return std::hash<std::string_view>{}(key);
+}
+
+const PropertyMap::Value* PropertyMap::find(std::string_view key, std::size_t hash) const
+{
+	const Node* node = this->root.get();
+	unsigned shift = 0;
+
+	while (node) {
+		if (node->collision) {
+			for (const auto& slot : node->slots) {
+				if (slot.key == key)
+					return &slot.value;
+			}
+
+			return nullptr;
+		}
+
+		std::uint32_t bit = 1u << ((hash >> shift) & LEVEL_MASK);
+
+		if (!(node->bitmap & bit))
+			return nullptr;
+
+		const Slot& slot = node->slots[slotIndex(node->bitmap, bit)];
+
+		if (!slot.child)
+			return slot.hash == hash && slot.key == key ? &slot.value : nullptr;
+
+		node = slot.child.get();
+		shift += BITS_PER_LEVEL;
+	}
+
+	return nullptr;
+}
+
+PropertyMap PropertyMap::set(std::string_view key, std::size_t hash, Value value) const
+{
+	Slot leaf;
+	leaf.hash = hash;
+	leaf.key = key;
+	leaf.value = std::move(value);
+
+	bool added = false;
+	auto updated = insert(this->root, std::move(leaf), 0, added);
+
+	return PropertyMap(std::move(updated), this->count + (added ? 1 : 0));
+}
+
+PropertyMap PropertyMap::erase(const std::string& key) const
+{
+	if (!this->root)
+		return *this;
+
+	bool removed = false;
+	auto updated = remove(this->root, hashKey(key), key, 0, removed);
+
+	if (!removed)
+		return *this;
+
+	return PropertyMap(std::move(updated), this->count - 1);
+}
+
+void PropertyMap::forEach(const std::function<void(const std::string&, const Value&)>& callback) const
+{
+	if (this->root)
+		visit(*this->root, callback);
+}
+
+std::vector<std::pair<std::string, PropertyMap::Value>> PropertyMap::entries() const
+{
+	std::vector<std::pair<std::string, Value>> result;
+	result.reserve(this->count);
+
+	this->forEach([&](const std::string& key, const Value& value) {
+		result.emplace_back(key, value);
+	});
+
+	std::sort(result.begin(), result.end(), [](const auto& lhs, const auto& rhs) {
+		return lhs.first < rhs.first;
+	});
+
+	return result;
+}
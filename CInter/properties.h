@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+struct RuntimeValue;
+
+// Immutable hash array mapped trie from property names to values. Updates return a new map that
+// shares every untouched node with the original, so copying is O(1) and deriving a variant costs
+// O(changed fields * log32 n) rather than O(size).
+class PropertyMap {
+	public:
+		using Value = std::shared_ptr<RuntimeValue>;
+
+		PropertyMap() = default;
+		PropertyMap(const PropertyMap&) = default;
+		PropertyMap(PropertyMap&&) noexcept = default;
+		~PropertyMap();
+
+		// The replaced map is released like a destroyed one.
+		PropertyMap& operator = (PropertyMap other) noexcept {
+			std::swap(this->root, other.root);
+			std::swap(this->count, other.count);
+			return *this;
+		}
+
+		std::size_t size() const { return this->count; }
+		bool empty() const { return this->count == 0; }
+
+		// Hash used for every key. Callers that look the same key up repeatedly can compute it once
+		// and pass it to the overloads below.
+		static std::size_t hashKey(std::string_view key);
+
+		const Value* find(std::string_view key) const { return this->find(key, hashKey(key)); }
+		const Value* find(std::string_view key, std::size_t hash) const;
+		bool contains(std::string_view key) const { return this->find(key) != nullptr; }
+
+		PropertyMap set(std::string_view key, Value value) const { return this->set(key, hashKey(key), std::move(value)); }
+		PropertyMap set(std::string_view key, std::size_t hash, Value value) const;
+		PropertyMap erase(const std::string& key) const;
+
+		void forEach(const std::function<void(const std::string&, const Value&)>& visit) const;
+		std::vector<std::pair<std::string, Value>> entries() const;
+
+		bool sharesStructureWith(const PropertyMap& other) const { return this->root == other.root; }
+
+		struct Node;
+
+	private:
+		std::shared_ptr<const Node> root;
+		std::size_t count = 0;
+
+		PropertyMap(std::shared_ptr<const Node> root, std::size_t count) : root(std::move(root)), count(count) {}
+};
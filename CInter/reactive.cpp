@@ -0,0 +1,202 @@
+#include "reactive.h"
+#include "interpreter.h"
+#include "memory.h"
+
+#include <stdexcept>
+
+namespace {
+
+bool sameValue(const std::shared_ptr<RuntimeValue>& previous, const std::shared_ptr<RuntimeValue>& current)
+{
+	if (previous == current)
+		return true;
+
+	if (!previous || !current || previous->getType() != current->getType())
+		return false;
+
+	switch (current->getType()) {
+		case ValueType::Null:
+			return true;
+
+		case ValueType::Number:
+			return static_cast<const NumberValue&>(*previous).value == static_cast<const NumberValue&>(*current).value;
+
+		case ValueType::Boolean:
+			return static_cast<const BooleanValue&>(*previous).value == static_cast<const BooleanValue&>(*current).value;
+
+		case ValueType::String:
+			return static_cast<const StringValue&>(*previous).view() == static_cast<const StringValue&>(*current).view();
+
+		default:
+			return false;
+	}
+}
+
+}
+
+ReactiveProgram::ReactiveProgram(std::unique_ptr<Program> program, std::shared_ptr<Environment> env)
+	: program(std::move(program)), env(std::move(env))
+{
+	for (const auto& statement : this->program->body) {
+		StatementDependencies dependencies = analyzeStatement(*statement);
+
+		if (!dependencies.writes.empty())
+			throw std::runtime_error("A reactive program cannot assign to " + *dependencies.writes.begin()
+				+ " at the top level; a refresh could not replay the assignment. Declare a new variable instead.");
+
+		if (statement->kind == NodeType::ImportDeclaration)
+			continue;
+
+		if (statement->kind != NodeType::VariableDeclaration) {
+			if (!dependencies.pure)
+				throw std::runtime_error("A reactive program can only call functions inside declarations; a refresh could not replay the call.");
+
+			continue;
+		}
+
+		auto& declaration = static_cast<const VariableDeclaration&>(*statement);
+		std::size_t index = this->declarations.size();
+
+		this->declarations.push_back({ &declaration, std::move(dependencies) });
+
+		for (const auto& name : this->declarations.back().dependencies.reads) {
+			this->readers[name].push_back(index);
+		}
+	}
+
+	this->env->setAssignmentListener([this](const std::string& name) {
+		if (!this->running)
+			this->invalidate(name);
+	});
+}
+
+ReactiveProgram::~ReactiveProgram()
+{
+	this->env->setAssignmentListener(nullptr);
+}
+
+std::shared_ptr<RuntimeValue> ReactiveProgram::run()
+{
+	MemoryPhaseScope phase(MemoryPhase::Evaluator);
+	std::shared_ptr<RuntimeValue> lastEvaluated = MAKE_NULL();
+
+	this->running = true;
+
+	try {
+		for (const auto& statement : this->program->body) {
+			lastEvaluated = evaluate(*statement, *this->env);
+		}
+	}
+	catch (...) {
+		this->running = false;
+		throw;
+	}
+
+	this->running = false;
+	this->stale.clear();
+	this->forced.clear();
+	this->changed.clear();
+
+	return lastEvaluated;
+}
+
+void ReactiveProgram::invalidate(const std::string& name)
+{
+	this->changed.insert(name);
+
+	std::vector<const std::string*> work = { &name };
+
+	while (!work.empty()) {
+		auto found = this->readers.find(*work.back());
+		work.pop_back();
+
+		if (found == this->readers.end())
+			continue;
+
+		for (std::size_t reader : found->second) {
+			if (this->stale.insert(reader).second)
+				work.push_back(&this->declarations[reader].node->identifier);
+		}
+	}
+}
+
+bool ReactiveProgram::inputsChanged(const Declaration& declaration) const
+{
+	for (const auto& name : declaration.dependencies.reads) {
+		if (this->changed.count(name))
+			return true;
+	}
+
+	return false;
+}
+
+std::size_t ReactiveProgram::refresh()
+{
+	MemoryPhaseScope phase(MemoryPhase::Evaluator);
+
+	for (std::size_t index = 0; index < this->declarations.size(); ++index) {
+		if (!this->declarations[index].dependencies.pure)
+			this->stale.insert(index);
+	}
+
+	this->stale.insert(this->forced.begin(), this->forced.end());
+
+	// A native called by a declaration may still assign to that declaration's own inputs, which would
+	// invalidate it forever; each one runs at most once per refresh and anything it re-invalidates
+	// waits for the next call.
+	std::set<std::size_t> done;
+	std::set<std::size_t> deferred;
+	std::size_t recomputed = 0;
+
+	while (!this->stale.empty()) {
+		std::size_t index = *this->stale.begin();
+		this->stale.erase(this->stale.begin());
+
+		if (done.count(index)) {
+			deferred.insert(index);
+			continue;
+		}
+
+		const Declaration& declaration = this->declarations[index];
+		bool force = this->forced.erase(index) > 0;
+
+		if (declaration.dependencies.pure && !force && !this->inputsChanged(declaration))
+			continue;
+
+		const std::string& name = declaration.node->identifier;
+		std::shared_ptr<RuntimeValue> value;
+
+		try {
+			value = declaration.node->value
+				? evaluate(*declaration.node->value, *this->env)
+				: MAKE_NULL();
+		}
+		catch (...) {
+			this->stale.insert(index);
+			this->stale.insert(deferred.begin(), deferred.end());
+			this->forced.insert(index);
+			this->forced.insert(deferred.begin(), deferred.end());
+			throw;
+		}
+
+		auto previous = this->env->lookupVariable(name);
+
+		this->env->redeclareVariable(name, value);
+		done.insert(index);
+		++recomputed;
+
+		if (!sameValue(previous, value))
+			this->changed.insert(name);
+	}
+
+	this->changed.clear();
+	this->stale = deferred;
+	this->forced = std::move(deferred);
+
+	return recomputed;
+}
+
+bool ReactiveProgram::isStale() const
+{
+	return !this->stale.empty();
+}
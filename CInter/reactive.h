@@ -0,0 +1,55 @@
+#pragma once
+
+#include "ast.h"
+#include "dependencies.h"
+#include "environment.h"
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+// Keeps the top-level declarations of a program up to date with their inputs. After run(), every
+// assignVariable on `env` marks the declarations that read the variable, directly or through other
+// declarations, as stale; refresh() re-evaluates only those, in program order, and stops propagating
+// past a declaration whose value came out unchanged, leaving `env` as re-running the program with the
+// new inputs would. An assignment could not be replayed that way, so the constructor rejects programs
+// whose top-level statements assign to anything; besides declarations, only expressions that neither
+// assign nor call are allowed, and those run once, in run().
+class ReactiveProgram {
+	private:
+		struct Declaration {
+			const VariableDeclaration* node;
+			StatementDependencies dependencies;
+		};
+
+		std::unique_ptr<Program> program;
+		std::shared_ptr<Environment> env;
+		std::vector<Declaration> declarations;
+		std::map<std::string, std::vector<std::size_t>> readers;
+
+		std::set<std::size_t> stale;
+		std::set<std::size_t> forced;
+		std::set<std::string> changed;
+		bool running = false;
+
+		void invalidate(const std::string& name);
+		bool inputsChanged(const Declaration& declaration) const;
+
+	public:
+		ReactiveProgram(std::unique_ptr<Program> program, std::shared_ptr<Environment> env);
+		~ReactiveProgram();
+
+		ReactiveProgram(const ReactiveProgram&) = delete;
+		ReactiveProgram& operator = (const ReactiveProgram&) = delete;
+
+		// Evaluates the whole program once, like evaluateProgram, and starts tracking changes.
+		std::shared_ptr<RuntimeValue> run();
+
+		// Returns the number of declarations that were re-evaluated.
+		std::size_t refresh();
+
+		bool isStale() const;
+};
@@ -0,0 +1,197 @@
+#include "scheduler.h"
+#include "async.h"
+
+#include <algorithm>
+#include <exception>
+
+Script::Script(std::unique_ptr<Program> program, std::shared_ptr<Environment> env, ScriptBudget budget)
+	: program(std::move(program)), env(std::move(env)), budget(budget),
+	  machine(*this->program, *this->env), lastEvaluated(MAKE_NULL())
+{
+	this->gauge.limit = budget.limit;
+}
+
+ScriptState Script::state() const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->status;
+}
+
+std::shared_ptr<RuntimeValue> Script::result() const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->lastEvaluated;
+}
+
+std::string Script::error() const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->failure;
+}
+
+std::uint64_t Script::fuelConsumed() const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->gauge.consumed;
+}
+
+std::uint64_t Script::timeSlices() const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->slices;
+}
+
+void Script::wait()
+{
+	std::unique_lock<std::mutex> lock(this->mutex);
+
+	this->done.wait(lock, [this] {
+		return this->status == ScriptState::Finished || this->status == ScriptState::Failed;
+	});
+}
+
+Scheduler::Scheduler(std::size_t workerCount)
+{
+	workerCount = std::max<std::size_t>(workerCount, 1);
+
+	for (std::size_t i = 0; i < workerCount; ++i) {
+		this->workers.emplace_back([this] { this->work(); });
+	}
+}
+
+Scheduler::~Scheduler()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->stopping = true;
+	}
+
+	this->available.notify_all();
+
+	for (auto& worker : this->workers) {
+		worker.join();
+	}
+}
+
+std::shared_ptr<Script> Scheduler::submit(std::unique_ptr<Program> program, std::shared_ptr<Environment> env, ScriptBudget budget)
+{
+	if (budget.quantum <= 0)
+		throw std::invalid_argument("A script's fuel quantum must be positive.");
+
+	auto script = std::make_shared<Script>(std::move(program), std::move(env), budget);
+
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		this->runQueue.push_back(script);
+		++this->pending;
+	}
+
+	this->available.notify_one();
+
+	return script;
+}
+
+void Scheduler::waitAll()
+{
+	std::unique_lock<std::mutex> lock(this->mutex);
+
+	this->idle.wait(lock, [this] { return this->pending == 0; });
+}
+
+void Scheduler::work()
+{
+	for (;;) {
+		std::shared_ptr<Script> script;
+
+		{
+			std::unique_lock<std::mutex> lock(this->mutex);
+
+			this->available.wait(lock, [this] { return this->stopping || !this->runQueue.empty(); });
+
+			if (this->stopping && this->runQueue.empty())
+				return;
+
+			script = std::move(this->runQueue.front());
+			this->runQueue.pop_front();
+		}
+
+		bool suspended = this->runSlice(*script);
+
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+
+			if (suspended)
+				this->runQueue.push_back(std::move(script));
+
+			else if (--this->pending == 0)
+				this->idle.notify_all();
+		}
+
+		if (suspended)
+			this->available.notify_one();
+	}
+}
+
+// Returns true when the script yielded and must be queued again.
+bool Scheduler::runSlice(Script& script)
+{
+	{
+		std::lock_guard<std::mutex> lock(script.mutex);
+
+		script.status = ScriptState::Running;
+		++script.slices;
+
+		// Overrunning the previous slice is paid back out of this one.
+		script.gauge.remaining = std::min<std::int64_t>(script.gauge.remaining, 0) + script.budget.quantum;
+	}
+
+	FuelGauge gauge = script.gauge;
+	std::shared_ptr<RuntimeValue> lastEvaluated;
+	std::string failure;
+	bool failed = false;
+	bool finished = false;
+
+	try {
+		FuelScope scope(gauge);
+		MemoryScope memoryScope(script.budget.memory.get(), MemoryPhase::Evaluator);
+		EvaluationMachine::Progress progress;
+
+		// Async natives are driven to completion on this worker, as a direct call would be.
+		while ((progress = script.machine.run(true)) == EvaluationMachine::Progress::Awaiting) {
+			script.machine.resumeWith(runNativeTask(std::move(script.machine.pendingCall())));
+		}
+
+		if (progress == EvaluationMachine::Progress::Finished) {
+			finished = true;
+			lastEvaluated = script.machine.result();
+		}
+	}
+	catch (const std::exception& error) {
+		failed = true;
+		finished = true;
+		failure = error.what();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(script.mutex);
+
+		script.gauge = gauge;
+
+		if (lastEvaluated)
+			script.lastEvaluated = std::move(lastEvaluated);
+
+		if (failed) {
+			script.status = ScriptState::Failed;
+			script.failure = std::move(failure);
+		}
+		else {
+			script.status = finished ? ScriptState::Finished : ScriptState::Queued;
+		}
+	}
+
+	if (finished)
+		script.done.notify_all();
+
+	return !finished;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "ast.h"
+#include "environment.h"
+#include "fuel.h"
+#include "iterative.h"
+#include "memory.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct ScriptBudget {
+	std::int64_t quantum = 10000;
+	std::uint64_t limit = 0;
+	std::shared_ptr<MemoryContext> memory;
+};
+
+enum class ScriptState {
+	Queued,
+	Running,
+	Finished,
+	Failed
+};
+
+// A submitted program and everything needed to resume it: the suspended evaluation of its
+// body, its environment and the fuel it has used so far.
+class Script {
+	private:
+		friend class Scheduler;
+
+		std::unique_ptr<Program> program;
+		std::shared_ptr<Environment> env;
+		ScriptBudget budget;
+		FuelGauge gauge;
+		EvaluationMachine machine;
+		std::uint64_t slices = 0;
+
+		mutable std::mutex mutex;
+		std::condition_variable done;
+		ScriptState status = ScriptState::Queued;
+		std::shared_ptr<RuntimeValue> lastEvaluated;
+		std::string failure;
+
+	public:
+		Script(std::unique_ptr<Program> program, std::shared_ptr<Environment> env, ScriptBudget budget);
+
+		ScriptState state() const;
+		std::shared_ptr<RuntimeValue> result() const;
+		std::string error() const;
+		std::uint64_t fuelConsumed() const;
+		std::uint64_t timeSlices() const;
+
+		void wait();
+};
+
+// Multiplexes scripts over a fixed set of worker threads. Each turn a script receives
+// its quantum of fuel and runs until that is spent, even in the middle of a statement,
+// then goes to the back of the run queue, so every runnable script progresses round-robin.
+class Scheduler {
+	private:
+		std::deque<std::shared_ptr<Script>> runQueue;
+		std::vector<std::thread> workers;
+		std::mutex mutex;
+		std::condition_variable available;
+		std::condition_variable idle;
+		std::size_t pending = 0;
+		bool stopping = false;
+
+		void work();
+		bool runSlice(Script& script);
+
+	public:
+		explicit Scheduler(std::size_t workerCount = std::thread::hardware_concurrency());
+		~Scheduler();
+
+		Scheduler(const Scheduler&) = delete;
+		Scheduler& operator = (const Scheduler&) = delete;
+
+		std::shared_ptr<Script> submit(std::unique_ptr<Program> program, std::shared_ptr<Environment> env, ScriptBudget budget = {});
+		void waitAll();
+};
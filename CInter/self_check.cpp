@@ -0,0 +1,684 @@
+#include "self_check.h"
+#include "async.h"
+#include "interpreter.h"
+#include "iterative.h"
+#include "jit.h"
+#include "modules.h"
+#include "parallel.h"
+#include "parser.h"
+#include "reactive.h"
+#include "scheduler.h"
+#include "snapshot.h"
+#include "value_numbering.h"
+
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+// A fresh directory under the system temporary path, removed with everything in it.
+class TemporaryDirectory {
+	private:
+		std::filesystem::path root;
+
+	public:
+		TemporaryDirectory() {
+			std::random_device device;
+
+			for (int attempt = 0; attempt < 16; ++attempt) {
+				root = std::filesystem::temp_directory_path() / ("cinter-check-" + std::to_string(device()));
+
+				if (std::filesystem::create_directory(root))
+					return;
+			}
+
+			throw std::runtime_error("Cannot create a temporary directory.");
+		}
+
+		~TemporaryDirectory() {
+			std::error_code error;
+			std::filesystem::remove_all(root, error);
+		}
+
+		TemporaryDirectory(const TemporaryDirectory&) = delete;
+		TemporaryDirectory& operator = (const TemporaryDirectory&) = delete;
+
+		const std::filesystem::path& path() const {
+			return root;
+		}
+
+		void write(const std::string& name, const std::string& contents) const {
+			std::ofstream file(root / name, std::ios::binary | std::ios::trunc);
+			file << contents;
+
+			if (!file.flush())
+				throw std::runtime_error("Cannot write " + (root / name).string() + ".");
+		}
+};
+
+std::shared_ptr<RuntimeValue> evaluateSource(std::string_view source, Environment& env)
+{
+	Parser parser;
+	auto program = parser.produceAST(source);
+
+	return evaluate(*program, env);
+}
+
+// Nests far past the recursive limit, which the explicit-stack parser and evaluator must accept
+// with their default options.
+bool checkDeepNesting(std::string& failure)
+{
+	constexpr std::size_t depth = 100000;
+	std::string source;
+
+	for (std::size_t i = 0; i < depth; ++i) {
+		source += "1 + (";
+	}
+
+	source += "0";
+	source.append(depth, ')');
+
+	Parser parser({ true });
+	auto program = parser.produceAST(source);
+
+	Environment env;
+	auto value = evaluateIterative(*program, env);
+
+	if (value->getType() != ValueType::Number || static_cast<const NumberValue&>(*value).value != depth) {
+		failure = "Expected " + std::to_string(depth) + " but evaluation produced " + formatValue(*value) + ".";
+		return false;
+	}
+
+	return true;
+}
+
+// Compiled code must agree with the tree-walking evaluator; jitSelfCheck seeds its trees itself.
+bool checkJit(std::string& failure)
+{
+	if (!jitAvailable())
+		return true;
+
+	return jitSelfCheck(10000, failure);
+}
+
+// Doubling a rope must stop at the length limit instead of wrapping its length around.
+bool checkStringLength(std::string& failure)
+{
+	std::string source = "let s = '" + std::string(128, 's') + "';\n";
+
+	for (int i = 0; i < 60; ++i) {
+		source += "s = s + s;\n";
+	}
+
+	source += "s = s + (s + 'y');\nlet o = {};\no[s] = 1;\n";
+
+	try {
+		Environment env;
+		evaluateSource(source, env);
+	}
+	catch (const std::runtime_error& error) {
+		if (std::string(error.what()).find("String length exceeds") != std::string::npos)
+			return true;
+
+		failure = std::string("Unexpected error: ") + error.what();
+		return false;
+	}
+
+	failure = "Doubling a string 60 times did not hit the length limit.";
+	return false;
+}
+
+// Objects nested far past the recursive limit must format and be released without recursion.
+bool checkDeepObjects(std::string& failure)
+{
+	constexpr std::size_t depth = 200000;
+
+	{
+		std::string source = "let o = ";
+
+		for (std::size_t i = 0; i < depth; ++i) {
+			source += "{ a: ";
+		}
+
+		source += "1";
+
+		for (std::size_t i = 0; i < depth; ++i) {
+			source += " }";
+		}
+
+		Parser parser({ true });
+		auto program = parser.produceAST(source);
+
+		Environment env;
+		std::string text = formatValue(*evaluateIterative(*program, env));
+
+		if (text.size() != depth * 7 + 1) {
+			failure = "Formatting a nested object produced " + std::to_string(text.size()) + " characters.";
+			return false;
+		}
+	}
+
+	std::string source = "let o = {};\n";
+
+	for (std::size_t i = 0; i < depth; ++i) {
+		source += "o = { a: o };\n";
+	}
+
+	source += "o = 0;\n";
+
+	Environment env;
+	evaluateSource(source, env);
+
+	return true;
+}
+
+// Numeric keys that differ only past the sixth significant digit must stay distinct keys.
+bool checkNumericKeys(std::string& failure)
+{
+	Environment env;
+	auto value = evaluateSource("let o = {};\no[1000001 / 3] = 1;\no[1000002 / 3] = 2;\no[1 / 3] = 3;\no[1000001 / 3] * 100 + o[1000002 / 3] * 10 + o[1 / 3]", env);
+	auto& object = static_cast<const ObjectValue&>(*env.lookupVariable("o"));
+
+	if (object.properties.size() != 3 || value->getType() != ValueType::Number || static_cast<const NumberValue&>(*value).value != 123) {
+		failure = "Numeric keys collided: " + formatValue(object) + ".";
+		return false;
+	}
+
+	for (double number : { 1.0 / 3, 0.1 + 0.2, 1e300 / 7, -2.5e-300, 123456789.125 }) {
+		if (std::stod(formatNumber(number)) != number) {
+			failure = formatNumber(number) + " does not read back as the number it was formatted from.";
+			return false;
+		}
+	}
+
+	return true;
+}
+
+std::string describeEnvironment(const Environment& env)
+{
+	std::string text;
+
+	env.forEachVariable([&](const std::string& name, const std::shared_ptr<RuntimeValue>& value) {
+		text += name + (env.isConstant(name) ? " (const) = " : " = ") + formatValue(*value) + "\n";
+	});
+
+	return text;
+}
+
+// A refresh after changing an input must leave the environment exactly as re-running the program
+// with that input would, and programs a refresh could not replay must be rejected up front.
+bool checkReactiveRefresh(std::string& failure)
+{
+	const std::string body = "let k = 3; let b = a * 2 + k; const c = b * b; let d = { b, c, k: k }; const e = d.c - a; let f = k + 1; e";
+
+	auto env = std::make_shared<Environment>();
+	Parser parser;
+	ReactiveProgram reactive(parser.produceAST("let a = 1; " + body), env);
+
+	reactive.run();
+	env->assignVariable("a", MAKE_NUMBER(5));
+	reactive.refresh();
+
+	Environment rerun;
+	evaluateSource("let a = 5; " + body, rerun);
+
+	if (describeEnvironment(*env) != describeEnvironment(rerun)) {
+		failure = "Refreshed:\n" + describeEnvironment(*env) + "Re-run:\n" + describeEnvironment(rerun);
+		return false;
+	}
+
+	try {
+		Parser rejected;
+		ReactiveProgram program(rejected.produceAST("let a = 1; let b = a * 2; b = b + 1; let c = b;"), std::make_shared<Environment>());
+	}
+	catch (const std::runtime_error&) {
+		return true;
+	}
+
+	failure = "A program assigning at the top level was accepted.";
+	return false;
+}
+
+// A single long statement must still be split across slices, and resuming it mid-statement must not
+// change its value.
+bool checkSchedulerPreemption(std::string& failure)
+{
+	constexpr int terms = 200;
+	std::string source = "let total = \"\"";
+
+	for (int i = 0; i < terms; ++i) {
+		source += " + \"x\"";
+	}
+
+	source += "; total";
+
+	std::shared_ptr<Script> script;
+
+	{
+		Scheduler scheduler(2);
+		Parser parser;
+		ScriptBudget budget;
+		budget.quantum = 16;
+
+		script = scheduler.submit(parser.produceAST(source), std::make_shared<Environment>(), budget);
+		scheduler.waitAll();
+	}
+
+	if (script->state() != ScriptState::Finished) {
+		failure = "The script did not finish: " + script->error();
+		return false;
+	}
+
+	auto value = script->result();
+
+	if (value->getType() != ValueType::String || static_cast<const StringValue&>(*value).size() != terms) {
+		failure = "Expected " + std::to_string(terms) + " characters but the script produced " + formatValue(*value) + ".";
+		return false;
+	}
+
+	if (script->timeSlices() < script->fuelConsumed() / 16) {
+		failure = "The script ran " + std::to_string(script->fuelConsumed()) + " nodes in only "
+			+ std::to_string(script->timeSlices()) + " slices.";
+		return false;
+	}
+
+	return true;
+}
+
+// S-expression of a parsed tree, for comparing the output of the two parsers.
+std::string describeNode(const Statement& node)
+{
+	switch (node.kind) {
+		case NodeType::Program: {
+			std::string text = "(program";
+
+			for (const auto& statement : static_cast<const Program&>(node).body) {
+				text += " " + describeNode(*statement);
+			}
+
+			return text + ")";
+		}
+
+		case NodeType::NumericLiteral:
+			return formatNumber(static_cast<const NumericLiteral&>(node).value);
+
+		case NodeType::StringLiteral:
+			return formatValue(*static_cast<const StringLiteral&>(node).value);
+
+		case NodeType::Identifier:
+			return static_cast<const _Identifier&>(node).symbol;
+
+		case NodeType::VariableDeclaration: {
+			auto& declaration = static_cast<const VariableDeclaration&>(node);
+
+			return std::string(declaration.constant ? "(const " : "(let ") + declaration.identifier
+				+ (declaration.value ? " " + describeNode(*declaration.value) : "") + ")";
+		}
+
+		case NodeType::ImportDeclaration: {
+			auto& declaration = static_cast<const ImportDeclaration&>(node);
+			std::string text = "(import";
+
+			for (const auto& segment : declaration.path) {
+				text += " " + segment;
+			}
+
+			return text + " as " + declaration.binding + ")";
+		}
+
+		case NodeType::BinaryExpression: {
+			auto& binop = static_cast<const BinaryExpression&>(node);
+
+			return "(" + binop._operator + " " + describeNode(*binop.left) + " " + describeNode(*binop.right) + ")";
+		}
+
+		case NodeType::AssignmentExpression: {
+			auto& assignment = static_cast<const AssignmentExpression&>(node);
+
+			return "(= " + describeNode(*assignment.assignee) + " " + describeNode(*assignment.value) + ")";
+		}
+
+		case NodeType::ObjectLiteral: {
+			std::string text = "(object";
+
+			for (const auto& property : static_cast<const ObjectLiteral&>(node).properties) {
+				text += " " + property->key + (property->value ? ": " + describeNode(*property->value) : "");
+			}
+
+			return text + ")";
+		}
+
+		case NodeType::MemberExpression: {
+			auto& member = static_cast<const MemberExpression&>(node);
+
+			return std::string(member.computed ? "([] " : "(. ") + describeNode(*member.object) + " " + describeNode(*member.property) + ")";
+		}
+
+		case NodeType::CallExpression: {
+			auto& call = static_cast<const CallExpression&>(node);
+			std::string text = "(call " + describeNode(*call.caller);
+
+			for (const auto& argument : call.args) {
+				text += " " + describeNode(*argument);
+			}
+
+			return text + ")";
+		}
+
+		default:
+			return "(?)";
+	}
+}
+
+std::string parseWith(ParserOptions options, std::string_view source)
+{
+	try {
+		Parser parser(options);
+		return describeNode(*parser.produceAST(source));
+	}
+	catch (const std::exception&) {
+		return "syntax error";
+	}
+}
+
+// The explicit-stack parser must accept exactly what recursive descent accepts, and build the
+// same tree from it.
+bool checkParsersAgree(std::string& failure)
+{
+	const char* corpus[] = {
+		"1 + 2 * 3 - 4 / 5 % 6",
+		"a = b = c + 1",
+		"a + b = c",
+		"x.y.z = f(1, g(2))(3)",
+		"a[b + 1][c] = { k: 1, m: { n: 2 }, p, }",
+		"f({ a: 1 }, { b: 2 })",
+		"({ a: 1 }).a + 1",
+		"o[{ a: 1 }]",
+		"let v = { a: x = 1 };",
+		"const w = (a + b) * c; w",
+		"import lib.math as m; m.two",
+		"\"a\" + \"b\"",
+		"a.(b)",
+		"a.((b)).c(1)",
+		"f(1).x",
+		"f(1)[0]",
+		"f(1)(2) * 3",
+		"{ a: 1 } (2)",
+		"{ a: 1 } = 3",
+		"x = { a: 1 } (2)",
+		"1 + { a: 1 }",
+		"(1 + { a: 1 })",
+		"f(1 * { a: 1 })",
+		"{ a: 1 }.a",
+		"{ a: 1 }[0]",
+		"{ a: 1 } + 1",
+		"f({ a: 1 }.a)",
+		"{ a: { b: 1 }.b }",
+		"a \"+\" b",
+		"a.(b.c)",
+		"a.(b",
+		"a.1",
+		"f(1,)",
+		"(a, b)",
+		"()",
+		"{ a }",
+		"{ a: 1",
+		"a ] b",
+		"a + b ] c",
+		"x = a * b )",
+		"(a }",
+		"f(a ]",
+	};
+
+	ParserOptions recursive;
+	ParserOptions iterative;
+	iterative.iterative = true;
+
+	for (const char* source : corpus) {
+		std::string expected = parseWith(recursive, source);
+		std::string actual = parseWith(iterative, source);
+
+		if (expected != actual) {
+			failure = std::string("For `") + source + "` recursive descent gave " + expected + " but the iterative parser gave " + actual + ".";
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Sharing subexpressions must not change what a program computes, and its temporaries must be
+// gone from the environment once they are released.
+bool checkValueNumbering(std::string& failure)
+{
+	const char* source = "let a = 3; let b = a * 2 + 1; let c = (a * 2 + 1) * (a * 2 + 1); "
+		"let d = { p: a * 2 + 1, q: c }; a = a + 1; const e = (a * 2 + 1) + (a * 2 + 1) + d.p; c + e";
+
+	Parser parser;
+	auto program = parser.produceAST(source);
+	auto report = eliminateCommonSubexpressions(*program);
+
+	if (report.temporaries == 0) {
+		failure = "No subexpression was shared.";
+		return false;
+	}
+
+	Environment shared;
+	auto value = evaluate(*program, shared);
+	releaseTemporaries(report, shared);
+
+	Environment plain;
+	auto expected = evaluateSource(source, plain);
+
+	if (formatValue(*value) != formatValue(*expected)) {
+		failure = "Expected " + formatValue(*expected) + " but the rewritten program produced " + formatValue(*value) + ".";
+		return false;
+	}
+
+	if (describeEnvironment(shared) != describeEnvironment(plain)) {
+		failure = "Rewritten:\n" + describeEnvironment(shared) + "Original:\n" + describeEnvironment(plain);
+		return false;
+	}
+
+	return true;
+}
+
+// Changing a module must reload it and every module importing it, and nothing else may reload.
+bool checkModuleInvalidation(std::string& failure)
+{
+	TemporaryDirectory directory;
+	ModuleCache& cache = ModuleCache::shared();
+
+	directory.write("util.cin", "const two = 2;");
+	directory.write("app.cin", "import util; const total = util.two * 10;");
+	cache.setSearchPaths({ directory.path() });
+
+	struct Restore {
+		ModuleCache& cache;
+
+		~Restore() {
+			cache.clear();
+			cache.setSearchPaths({});
+		}
+	} restore { cache };
+
+	auto importTotal = [](std::uint64_t expected, std::string& failure) {
+		Environment env;
+		auto value = evaluateSource("import app; app.total", env);
+
+		if (value->getType() != ValueType::Number || static_cast<const NumberValue&>(*value).value != expected) {
+			failure = "Expected app.total to be " + std::to_string(expected) + " but it was " + formatValue(*value) + ".";
+			return false;
+		}
+
+		return true;
+	};
+
+	std::uint64_t before = cache.loads();
+
+	if (!importTotal(20, failure) || !importTotal(20, failure))
+		return false;
+
+	if (cache.loads() - before != 2) {
+		failure = "Importing an unchanged chain twice loaded " + std::to_string(cache.loads() - before) + " modules instead of 2.";
+		return false;
+	}
+
+	directory.write("util.cin", "const two = 20;");
+
+	if (!importTotal(200, failure))
+		return false;
+
+	if (cache.loads() - before != 4) {
+		failure = "Changing the dependency reloaded " + std::to_string(cache.loads() - before - 2) + " modules instead of 2.";
+		return false;
+	}
+
+	return true;
+}
+
+// A restored snapshot must declare the same variables with the same values, keep shared values
+// shared and bind natives back to the registered ones; a failed restore must change nothing.
+bool checkSnapshotRoundTrip(std::string& failure)
+{
+	TemporaryDirectory directory;
+	std::string path = (directory.path() / "globals.snapshot").string();
+
+	Environment saved;
+	declareAsyncBuiltins(saved);
+	evaluateSource("let a = 1; const s = \"text\"; let o = { a: a, s: s, inner: { k: 2 } }; const p = { o: o, again: o }; let n;", saved);
+	writeSnapshot(saved, path);
+
+	Environment restored;
+	restoreSnapshot(restored, path);
+
+	if (describeEnvironment(restored) != describeEnvironment(saved)) {
+		failure = "Saved:\n" + describeEnvironment(saved) + "Restored:\n" + describeEnvironment(restored);
+		return false;
+	}
+
+	auto& object = static_cast<const ObjectValue&>(*restored.lookupVariable("p"));
+	auto first = object.properties.find("o", PropertyMap::hashKey("o"));
+	auto second = object.properties.find("again", PropertyMap::hashKey("again"));
+
+	if (!first || !second || *first != *second) {
+		failure = "A value reachable twice was restored as two copies.";
+		return false;
+	}
+
+	if (restored.lookupVariable("sleep") != saved.lookupVariable("sleep")) {
+		failure = "A native was not bound back to the registered one.";
+		return false;
+	}
+
+	Environment clashing;
+	clashing.declareVariable("s", MAKE_NUMBER(7), false);
+
+	try {
+		restoreSnapshot(clashing, path);
+	}
+	catch (const std::runtime_error&) {
+		if (describeEnvironment(clashing) != "s = 7\n") {
+			failure = "A failed restore left:\n" + describeEnvironment(clashing);
+			return false;
+		}
+
+		return true;
+	}
+
+	failure = "Restoring over an existing variable succeeded.";
+	return false;
+}
+
+// evaluateParallel must leave the environment and produce the value, or the error, of the
+// sequential run.
+bool checkParallelEvaluation(std::string& failure)
+{
+	std::string source = "let base = 3;";
+
+	for (int i = 0; i < 64; ++i) {
+		std::string name = "v" + std::string(1, char('a' + i % 26)) + std::string(1, char('a' + i / 26));
+		source += " const " + name + " = base * " + std::to_string(i) + " + ({ k: base }).k;";
+	}
+
+	source += " base = base + vaa + vzb; let after = base * 2; let text = \"n\" + after; { t: text, b: base }";
+
+	auto outcome = [](const std::string& source, bool parallel) {
+		Parser parser;
+		auto program = parser.produceAST(source);
+		Environment env;
+
+		try {
+			auto value = parallel ? evaluateParallel(*program, env) : evaluate(*program, env);
+			return formatValue(*value) + "\n" + describeEnvironment(env);
+		}
+		catch (const std::runtime_error& error) {
+			return std::string("error: ") + error.what() + "\n" + describeEnvironment(env);
+		}
+	};
+
+	for (const std::string& program : { source, source + " let late = missing + 1; let never = 2;" }) {
+		std::string sequential = outcome(program, false);
+		std::string parallel = outcome(program, true);
+
+		if (parallel != sequential) {
+			failure = "Sequential:\n" + sequential + "Parallel:\n" + parallel;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+struct SelfCheck {
+	const char* name;
+	bool (*run)(std::string& failure);
+};
+
+const SelfCheck checks[] = {
+	{ "deep nesting", checkDeepNesting },
+	{ "iterative parser against recursive descent", checkParsersAgree },
+	{ "jit against interpreter", checkJit },
+	{ "string length limit", checkStringLength },
+	{ "deep objects", checkDeepObjects },
+	{ "numeric property keys", checkNumericKeys },
+	{ "reactive refresh against re-run", checkReactiveRefresh },
+	{ "scheduler preemption", checkSchedulerPreemption },
+	{ "value numbering against plain evaluation", checkValueNumbering },
+	{ "module invalidation", checkModuleInvalidation },
+	{ "snapshot round trip", checkSnapshotRoundTrip },
+	{ "parallel against sequential evaluation", checkParallelEvaluation },
+};
+
+}
+
+bool runSelfChecks(std::ostream& out)
+{
+	bool passed = true;
+
+	for (const SelfCheck& check : checks) {
+		std::string failure;
+		bool ok;
+
+		try {
+			ok = check.run(failure);
+		}
+		catch (const std::exception& error) {
+			failure = error.what();
+			ok = false;
+		}
+
+		out << (ok ? "ok     " : "FAILED ") << check.name;
+
+		if (!ok)
+			out << ": " << failure;
+
+		out << std::endl;
+		passed = passed && ok;
+	}
+
+	return passed;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <ostream>
+
+// Runs the interpreter's built-in consistency checks with fixed inputs, reporting each one to `out`.
+// Returns false when any of them fails.
+bool runSelfChecks(std::ostream& out);
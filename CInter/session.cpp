@@ -0,0 +1,82 @@
+#include "session.h"
+#include "interpreter.h"
+#include "memory.h"
+
+Session::Session(std::shared_ptr<Environment> env, ParserOptions options)
+	: env(std::move(env)), options(options)
+{
+}
+
+SessionResult Session::submit(const std::string& input)
+{
+	SessionResult result;
+
+	char quote = 0;
+	bool escaped = false;
+
+	// Brackets inside string literals do not count.
+	for (char ch : input) {
+		if (quote) {
+			if (escaped)
+				escaped = false;
+
+			else if (ch == '\\')
+				escaped = true;
+
+			else if (ch == quote)
+				quote = 0;
+		}
+
+		else if (ch == '"' || ch == '\'')
+			quote = ch;
+
+		else if (ch == '(' || ch == '{' || ch == '[')
+			++this->openBrackets;
+
+		else if (ch == ')' || ch == '}' || ch == ']')
+			--this->openBrackets;
+	}
+
+	this->buffered += input;
+
+	if (this->openBrackets > 0)
+		return result;
+
+	std::string chunk = std::move(this->buffered);
+	this->discardBuffered();
+
+	Parser parser(this->options);
+	auto program = parser.produceAST(chunk);
+
+	MemoryPhaseScope phase(MemoryPhase::Evaluator);
+
+	result.complete = true;
+
+	for (auto& statement : program->body) {
+		result.value = evaluate(*statement, *this->env);
+		this->history.body.push_back(std::move(statement));
+	}
+
+	return result;
+}
+
+bool Session::isBuffering() const
+{
+	return !this->buffered.empty();
+}
+
+void Session::discardBuffered()
+{
+	this->buffered.clear();
+	this->openBrackets = 0;
+}
+
+const Program& Session::program() const
+{
+	return this->history;
+}
+
+Environment& Session::environment()
+{
+	return *this->env;
+}
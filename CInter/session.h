@@ -0,0 +1,45 @@
+#pragma once
+
+#include "ast.h"
+#include "environment.h"
+#include "parser.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+struct SessionResult {
+	// False while the buffered input still has unclosed brackets and nothing was evaluated.
+	bool complete = false;
+
+	// Value of the last statement of the chunk, or nullptr when it contained none.
+	std::shared_ptr<RuntimeValue> value;
+};
+
+// A long-lived program that grows one chunk at a time. Each submitted chunk is lexed, parsed and
+// evaluated on its own against the persistent environment, then its statements are appended to the
+// history, so earlier nodes keep their JIT state and the cost of a chunk does not grow with the session.
+class Session {
+	private:
+		Program history;
+		std::shared_ptr<Environment> env;
+		ParserOptions options;
+		std::string buffered;
+		long openBrackets = 0;
+
+	public:
+		Session(std::shared_ptr<Environment> env = std::make_shared<Environment>(), ParserOptions options = {});
+
+		Session(const Session&) = delete;
+		Session& operator = (const Session&) = delete;
+
+		// Syntax errors discard the buffered chunk. Runtime errors keep the statements that ran before the
+		// failing one, exactly as if they had been submitted on their own.
+		SessionResult submit(const std::string& input);
+
+		bool isBuffering() const;
+		void discardBuffered();
+
+		const Program& program() const;
+		Environment& environment();
+};
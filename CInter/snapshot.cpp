@@ -0,0 +1,435 @@
+#include "snapshot.h"
+#include "mapped_file.h"
+#include "natives.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace {
+
+constexpr char SNAPSHOT_MAGIC[8] = { 'C', 'I', 'N', 'S', 'N', 'A', 'P', '\0' };
+constexpr std::uint32_t SNAPSHOT_VERSION = 1;
+constexpr std::uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304;
+
+// Kinds as stored on disk, independent of the order of ValueType.
+enum class StoredType : std::uint8_t {
+	Null,
+	Boolean,
+	Number,
+	String,
+	Object,
+	Native,
+	AsyncNative
+};
+
+constexpr std::uint8_t STORED_INTERNED = 1;
+
+struct SnapshotHeader {
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t byteOrder;
+	std::uint32_t valueCount;
+	std::uint32_t propertyCount;
+	std::uint32_t bindingCount;
+	std::uint32_t reserved;
+	std::uint64_t valuesOffset;
+	std::uint64_t propertiesOffset;
+	std::uint64_t bindingsOffset;
+	std::uint64_t textOffset;
+	std::uint64_t textSize;
+};
+
+// Every value precedes the values that refer to it. Numbers and booleans keep their bits in
+// `payload`; strings and native names are `payload` bytes at `first` in the text section; objects
+// own `count` property records starting at index `first`.
+struct StoredValue {
+	StoredType type;
+	std::uint8_t flags;
+	std::uint16_t reserved;
+	std::uint32_t count;
+	std::uint64_t first;
+	std::uint64_t payload;
+};
+
+struct StoredProperty {
+	std::uint64_t keyOffset;
+	std::uint32_t keyLength;
+	std::uint32_t value;
+};
+
+struct StoredBinding {
+	std::uint64_t nameOffset;
+	std::uint32_t nameLength;
+	std::uint32_t value;
+	std::uint32_t constant;
+	std::uint32_t reserved;
+};
+
+class SnapshotWriter {
+	private:
+		std::map<const RuntimeValue*, std::uint32_t> indexes;
+		std::vector<StoredValue> values;
+		std::vector<StoredProperty> properties;
+		std::vector<StoredBinding> bindings;
+		std::string text;
+
+		std::uint64_t addText(std::string_view bytes) {
+			std::uint64_t offset = this->text.size();
+
+			this->text += bytes;
+
+			return offset;
+		}
+
+		void emit(const std::shared_ptr<RuntimeValue>& value) {
+			StoredValue stored {};
+
+			switch (value->getType()) {
+				case ValueType::Null:
+					stored.type = StoredType::Null;
+					break;
+
+				case ValueType::Boolean:
+					stored.type = StoredType::Boolean;
+					stored.payload = static_cast<const BooleanValue&>(*value).value ? 1 : 0;
+					break;
+
+				case ValueType::Number: {
+					double number = static_cast<const NumberValue&>(*value).value;
+
+					stored.type = StoredType::Number;
+					std::memcpy(&stored.payload, &number, sizeof(number));
+					break;
+				}
+
+				case ValueType::String: {
+					auto string = std::static_pointer_cast<StringValue>(value);
+					std::string_view chars = string->view();
+
+					stored.type = StoredType::String;
+					stored.flags = findInternedString(chars) == string ? STORED_INTERNED : 0;
+					stored.first = this->addText(chars);
+					stored.payload = chars.size();
+					break;
+				}
+
+				case ValueType::Object: {
+					auto entries = static_cast<const ObjectValue&>(*value).properties.entries();
+
+					stored.type = StoredType::Object;
+					stored.first = this->properties.size();
+					stored.count = static_cast<std::uint32_t>(entries.size());
+
+					for (const auto& entry : entries) {
+						StoredProperty property {};
+
+						property.keyOffset = this->addText(entry.first);
+						property.keyLength = static_cast<std::uint32_t>(entry.first.size());
+						property.value = this->indexes.at(entry.second.get());
+						this->properties.push_back(property);
+					}
+
+					break;
+				}
+
+				case ValueType::nativeFunction:
+				case ValueType::asyncNativeFunction: {
+					std::string name = NativeRegistry::shared().nameOf(*value);
+
+					if (name.empty())
+						throw std::runtime_error("Cannot snapshot a native function that is not registered.");
+
+					stored.type = value->getType() == ValueType::nativeFunction ? StoredType::Native : StoredType::AsyncNative;
+					stored.first = this->addText(name);
+					stored.payload = name.size();
+					break;
+				}
+
+				default:
+					throw std::runtime_error("Cannot snapshot a value of this type.");
+			}
+
+			this->indexes.emplace(value.get(), static_cast<std::uint32_t>(this->values.size()));
+			this->values.push_back(stored);
+		}
+
+		template<typename Record>
+		void append(std::string& out, const std::vector<Record>& records) {
+			out.append(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(Record));
+		}
+
+	public:
+		// Post-order without recursion: an object is emitted once all of its property values are.
+		std::uint32_t add(const std::shared_ptr<RuntimeValue>& root) {
+			std::vector<std::pair<std::shared_ptr<RuntimeValue>, bool>> pending { { root, false } };
+
+			while (!pending.empty()) {
+				auto [value, expanded] = pending.back();
+
+				if (this->indexes.count(value.get())) {
+					pending.pop_back();
+					continue;
+				}
+
+				if (value->getType() == ValueType::Object && !expanded) {
+					pending.back().second = true;
+
+					static_cast<const ObjectValue&>(*value).properties.forEach([&](const std::string&, const PropertyMap::Value& property) {
+						if (!this->indexes.count(property.get()))
+							pending.push_back({ property, false });
+					});
+
+					continue;
+				}
+
+				pending.pop_back();
+				this->emit(value);
+			}
+
+			return this->indexes.at(root.get());
+		}
+
+		void bind(const std::string& name, const std::shared_ptr<RuntimeValue>& value, bool constant) {
+			StoredBinding binding {};
+
+			binding.value = this->add(value);
+			binding.nameOffset = this->addText(name);
+			binding.nameLength = static_cast<std::uint32_t>(name.size());
+			binding.constant = constant ? 1 : 0;
+			this->bindings.push_back(binding);
+		}
+
+		std::string serialize() {
+			SnapshotHeader header {};
+
+			std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+			header.version = SNAPSHOT_VERSION;
+			header.byteOrder = SNAPSHOT_BYTE_ORDER;
+			header.valueCount = static_cast<std::uint32_t>(this->values.size());
+			header.propertyCount = static_cast<std::uint32_t>(this->properties.size());
+			header.bindingCount = static_cast<std::uint32_t>(this->bindings.size());
+			header.valuesOffset = sizeof(SnapshotHeader);
+			header.propertiesOffset = header.valuesOffset + this->values.size() * sizeof(StoredValue);
+			header.bindingsOffset = header.propertiesOffset + this->properties.size() * sizeof(StoredProperty);
+			header.textOffset = header.bindingsOffset + this->bindings.size() * sizeof(StoredBinding);
+			header.textSize = this->text.size();
+
+			std::string out(reinterpret_cast<const char*>(&header), sizeof(header));
+
+			this->append(out, this->values);
+			this->append(out, this->properties);
+			this->append(out, this->bindings);
+			out += this->text;
+
+			return out;
+		}
+};
+
+[[noreturn]] void corrupt(const std::string& path)
+{
+	throw std::runtime_error("Snapshot " + path + " is corrupt.");
+}
+
+class SnapshotReader {
+	private:
+		std::string path;
+		std::string_view data;
+		SnapshotHeader header {};
+
+		void check(std::uint64_t offset, std::uint64_t size) const {
+			if (offset > this->data.size() || size > this->data.size() - offset)
+				corrupt(this->path);
+		}
+
+	public:
+		SnapshotReader(std::string path, std::string_view data) : path(std::move(path)), data(data) {
+			this->check(0, sizeof(SnapshotHeader));
+			std::memcpy(&this->header, data.data(), sizeof(SnapshotHeader));
+
+			if (std::memcmp(this->header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0)
+				throw std::runtime_error(this->path + " is not a snapshot.");
+
+			if (this->header.version != SNAPSHOT_VERSION || this->header.byteOrder != SNAPSHOT_BYTE_ORDER)
+				throw std::runtime_error("Snapshot " + this->path + " was written by an incompatible build.");
+
+			this->check(this->header.valuesOffset, std::uint64_t(this->header.valueCount) * sizeof(StoredValue));
+			this->check(this->header.propertiesOffset, std::uint64_t(this->header.propertyCount) * sizeof(StoredProperty));
+			this->check(this->header.bindingsOffset, std::uint64_t(this->header.bindingCount) * sizeof(StoredBinding));
+			this->check(this->header.textOffset, this->header.textSize);
+		}
+
+		const SnapshotHeader& layout() const { return this->header; }
+
+		// Records are copied out rather than cast in place; the mapping need not be aligned for them.
+		template<typename Record>
+		Record record(std::uint64_t sectionOffset, std::uint64_t index) const {
+			Record result;
+			std::memcpy(&result, this->data.data() + sectionOffset + index * sizeof(Record), sizeof(Record));
+			return result;
+		}
+
+		std::string_view text(std::uint64_t offset, std::uint64_t length) const {
+			if (offset > this->header.textSize || length > this->header.textSize - offset)
+				corrupt(this->path);
+
+			return this->data.substr(this->header.textOffset + offset, length);
+		}
+};
+
+// Every writer gets a file of its own next to `path`, created exclusively, so concurrent writers of
+// the same snapshot never share a temporary and each rename publishes one complete file.
+std::FILE* createTemporary(const std::string& path, std::string& temporary)
+{
+	std::random_device device;
+	std::mt19937_64 random((std::uint64_t(device()) << 32) ^ device());
+
+	for (int attempt = 0; attempt < 16; ++attempt) {
+		char suffix[32];
+
+		std::snprintf(suffix, sizeof(suffix), ".%016llx.tmp", static_cast<unsigned long long>(random()));
+		temporary = path + suffix;
+
+		if (std::FILE* file = std::fopen(temporary.c_str(), "wbx"))
+			return file;
+	}
+
+	throw std::runtime_error("Cannot create a temporary file for snapshot " + path + ".");
+}
+
+}
+
+void writeSnapshot(const Environment& env, const std::string& path)
+{
+	SnapshotWriter writer;
+
+	env.forEachVariable([&](const std::string& name, const std::shared_ptr<RuntimeValue>& value) {
+		writer.bind(name, value, env.isConstant(name));
+	});
+
+	std::string contents = writer.serialize();
+	std::string temporary;
+	std::FILE* file = createTemporary(path, temporary);
+
+	bool written = std::fwrite(contents.data(), 1, contents.size(), file) == contents.size();
+	written = std::fclose(file) == 0 && written;
+
+	std::error_code error;
+
+	if (written)
+		std::filesystem::rename(temporary, path, error);
+
+	if (!written || error) {
+		std::filesystem::remove(temporary, error);
+		throw std::runtime_error("Cannot write snapshot " + path + ".");
+	}
+}
+
+void restoreSnapshot(Environment& env, const std::string& path)
+{
+	MappedFile file(path);
+	SnapshotReader reader(path, file.contents());
+	const SnapshotHeader& header = reader.layout();
+	std::vector<std::shared_ptr<RuntimeValue>> values;
+
+	values.reserve(header.valueCount);
+
+	for (std::uint32_t i = 0; i < header.valueCount; ++i) {
+		auto stored = reader.record<StoredValue>(header.valuesOffset, i);
+
+		switch (stored.type) {
+			case StoredType::Null:
+				values.push_back(MAKE_NULL());
+				break;
+
+			case StoredType::Boolean:
+				values.push_back(MAKE_BOOL(stored.payload != 0));
+				break;
+
+			case StoredType::Number: {
+				double number;
+
+				std::memcpy(&number, &stored.payload, sizeof(number));
+				values.push_back(MAKE_NUMBER(number));
+				break;
+			}
+
+			case StoredType::String: {
+				std::string_view chars = reader.text(stored.first, stored.payload);
+
+				if (stored.flags & STORED_INTERNED)
+					values.push_back(internString(chars));
+				else
+					values.push_back(MAKE_STRING(chars));
+
+				break;
+			}
+
+			case StoredType::Object: {
+				if (stored.first > header.propertyCount || stored.count > header.propertyCount - stored.first)
+					corrupt(path);
+
+				PropertyMap properties;
+
+				for (std::uint32_t j = 0; j < stored.count; ++j) {
+					auto property = reader.record<StoredProperty>(header.propertiesOffset, stored.first + j);
+
+					if (property.value >= i)
+						corrupt(path);
+
+					properties = properties.set(reader.text(property.keyOffset, property.keyLength), values[property.value]);
+				}
+
+				values.push_back(MAKE_OBJECT(std::move(properties)));
+				break;
+			}
+
+			case StoredType::Native:
+			case StoredType::AsyncNative: {
+				std::string name(reader.text(stored.first, stored.payload));
+				auto native = NativeRegistry::shared().find(name);
+				ValueType expected = stored.type == StoredType::Native ? ValueType::nativeFunction : ValueType::asyncNativeFunction;
+
+				if (!native || native->getType() != expected)
+					throw std::runtime_error("Snapshot " + path + " refers to native " + name + ", which is not registered.");
+
+				values.push_back(std::move(native));
+				break;
+			}
+
+			default:
+				corrupt(path);
+		}
+	}
+
+	// Every binding is checked before the first is declared, so a bad snapshot leaves `env` untouched.
+	std::vector<std::pair<std::string, StoredBinding>> bindings;
+	std::set<std::string_view> names;
+
+	bindings.reserve(header.bindingCount);
+
+	for (std::uint32_t i = 0; i < header.bindingCount; ++i) {
+		auto binding = reader.record<StoredBinding>(header.bindingsOffset, i);
+		std::string_view name = reader.text(binding.nameOffset, binding.nameLength);
+
+		if (binding.value >= values.size() || !names.insert(name).second)
+			corrupt(path);
+
+		if (env.declaresVariable(std::string(name)))
+			throw std::runtime_error("Cannot declare variable " + std::string(name) + ". As it already is defined.");
+
+		bindings.emplace_back(std::string(name), binding);
+	}
+
+	for (const auto& [name, binding] : bindings) {
+		env.declareVariable(name, values[binding.value], binding.constant != 0);
+	}
+}
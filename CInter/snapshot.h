@@ -0,0 +1,18 @@
+#pragma once
+
+#include "environment.h"
+
+#include <string>
+
+// A snapshot holds the variables declared in one environment scope and every value they reach,
+// typically a global environment right after its natives were declared and its prelude ran. Values
+// refer to each other by index, so shared values stay shared, and natives are stored by their
+// NativeRegistry name.
+
+// Throws if a reachable native is not registered. The file is written under a temporary name of its
+// own and renamed into place, so concurrent writers never leave a torn file; the last rename wins.
+void writeSnapshot(const Environment& env, const std::string& path);
+
+// Maps the file and declares its variables in `env`, which must not declare any of them yet. Every
+// native it names must already be registered. On any error `env` is left as it was.
+void restoreSnapshot(Environment& env, const std::string& path);
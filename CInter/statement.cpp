@@ -1 +1,43 @@
 #include "statement.h"
+#include "interpreter.h"
+#include "memory.h"
+#include "modules.h"
+
+std::shared_ptr<RuntimeValue> evaluateProgram(const Program& program, Environment& env)
+{
+	MemoryPhaseScope phase(MemoryPhase::Evaluator);
+	std::shared_ptr<RuntimeValue> lastEvaluated = MAKE_NULL();
+
+	for (const auto& statement : program.body) {
+		lastEvaluated = evaluate(*statement, env);
+	}
+
+	return lastEvaluated;
+}
+
+std::shared_ptr<RuntimeValue> evaluateVariableDeclaration(const VariableDeclaration& declaration, Environment& env)
+{
+	std::shared_ptr<RuntimeValue> value = declaration.value
+		? evaluate(*declaration.value, env)
+		: MAKE_NULL();
+
+	return env.declareVariable(declaration.identifier, value, declaration.constant);
+}
+
+std::shared_ptr<RuntimeValue> evaluateImportDeclaration(const ImportDeclaration& declaration, Environment& env)
+{
+	if (env.declaresVariable(declaration.binding)) {
+		std::string name;
+
+		for (const auto& segment : declaration.path) {
+			name += (name.empty() ? "" : ".") + segment;
+		}
+
+		throw std::runtime_error("Cannot import " + name + " as " + declaration.binding + ", which is already declared. Use 'import "
+			+ name + " as <name>;' to bind it under another name.");
+	}
+
+	auto module = ModuleCache::shared().load(declaration.path);
+
+	return env.declareVariable(declaration.binding, module->exports, true);
+}
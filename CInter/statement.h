@@ -4,5 +4,6 @@
 #include "ast.h"
 #include <memory>
 
-std::unique_ptr<RuntimeValue> evaluateProgram(std::unique_ptr<Program> program);
-std::unique_ptr<RuntimeValue> evaluateVariableDeclaration();
\ No newline at end of file
+std::shared_ptr<RuntimeValue> evaluateProgram(const Program& program, Environment& env);
+std::shared_ptr<RuntimeValue> evaluateVariableDeclaration(const VariableDeclaration& declaration, Environment& env);
+std::shared_ptr<RuntimeValue> evaluateImportDeclaration(const ImportDeclaration& declaration, Environment& env);
\ No newline at end of file
@@ -0,0 +1,226 @@
+#include "values.h"
+#include "memory.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+namespace {
+
+// Results up to this length are copied into a flat string rather than linked as a rope node.
+constexpr std::size_t ROPE_THRESHOLD = 64;
+
+thread_local std::vector<std::shared_ptr<StringValue>> releasedStrings;
+thread_local bool releasingStrings = false;
+
+// Entries do not keep their strings alive. `value` tells whether an entry still belongs to the
+// string being destroyed, since a new string may take over the text while the old one dies.
+struct InternEntry {
+	const StringValue* value;
+	std::weak_ptr<StringValue> handle;
+};
+
+struct InternTable {
+	std::mutex mutex;
+	std::unordered_map<std::string_view, InternEntry> strings;
+};
+
+// Intentionally leaked: strings may be released during static destruction. Only the table's own
+// bookkeeping is untracked; the strings are charged to whoever interned them.
+InternTable& internTable()
+{
+	static InternTable* table = [] {
+		MemoryScope untracked(nullptr);
+		return new InternTable();
+	}();
+
+	return *table;
+}
+
+std::size_t checkedLength(std::size_t length)
+{
+	if (length > StringValue::MAX_LENGTH)
+		throw std::runtime_error("String length exceeds the limit of " + std::to_string(StringValue::MAX_LENGTH) + " characters.");
+
+	return length;
+}
+
+// Both operands are at most MAX_LENGTH long, so their sum cannot wrap.
+std::size_t concatenatedLength(const StringValue& left, const StringValue& right)
+{
+	return checkedLength(left.size() + right.size());
+}
+
+}
+
+StringValue::StringValue(std::string_view text) : length(checkedLength(text.size()))
+{
+	if (this->length <= INLINE_CAPACITY) {
+		std::memcpy(this->small, text.data(), this->length);
+		this->flat.store(this->small, std::memory_order_relaxed);
+
+		return;
+	}
+
+	this->buffer.reset(new char[this->length]);
+	std::memcpy(this->buffer.get(), text.data(), this->length);
+	this->flat.store(this->buffer.get(), std::memory_order_relaxed);
+}
+
+StringValue::StringValue(std::shared_ptr<StringValue> left, std::shared_ptr<StringValue> right)
+	: length(concatenatedLength(*left, *right)), left(std::move(left)), right(std::move(right))
+{
+}
+
+// A rope built by appending in a loop is as deep as it is long, so children are released through
+// a work list instead of recursively.
+StringValue::~StringValue()
+{
+	if (this->interned) {
+		InternTable& table = internTable();
+		std::lock_guard<std::mutex> lock(table.mutex);
+		auto found = table.strings.find(std::string_view(this->flat.load(std::memory_order_relaxed), this->length));
+
+		if (found != table.strings.end() && found->second.value == this)
+			table.strings.erase(found);
+
+		return;
+	}
+
+	if (!this->left)
+		return;
+
+	try {
+		releasedStrings.push_back(std::move(this->left));
+		releasedStrings.push_back(std::move(this->right));
+	}
+	catch (...) {
+		this->left.reset();
+		this->right.reset();
+		return;
+	}
+
+	if (releasingStrings)
+		return;
+
+	releasingStrings = true;
+
+	while (!releasedStrings.empty()) {
+		auto released = std::move(releasedStrings.back());
+		releasedStrings.pop_back();
+	}
+
+	releasingStrings = false;
+}
+
+// Children are never modified, so several threads may read the same rope; only the flat copy of
+// each node is published, exactly once.
+void StringValue::flatten() const
+{
+	std::unique_ptr<char[]> text(new char[this->length]);
+	std::vector<const StringValue*> pending { this->right.get(), this->left.get() };
+	char* out = text.get();
+
+	while (!pending.empty()) {
+		const StringValue* node = pending.back();
+		pending.pop_back();
+
+		if (const char* chars = node->flat.load(std::memory_order_acquire)) {
+			std::memcpy(out, chars, node->length);
+			out += node->length;
+			continue;
+		}
+
+		pending.push_back(node->right.get());
+		pending.push_back(node->left.get());
+	}
+
+	this->buffer = std::move(text);
+	this->flat.store(this->buffer.get(), std::memory_order_release);
+}
+
+std::string_view StringValue::view() const
+{
+	const char* chars = this->flat.load(std::memory_order_acquire);
+
+	if (!chars) {
+		std::call_once(this->flattened, [this] { this->flatten(); });
+		chars = this->flat.load(std::memory_order_acquire);
+	}
+
+	return std::string_view(chars, this->length);
+}
+
+std::size_t StringValue::hash() const
+{
+	std::size_t hash = this->cachedHash.load(std::memory_order_relaxed);
+
+	if (hash == 0) {
+		hash = PropertyMap::hashKey(this->view());
+		this->cachedHash.store(hash, std::memory_order_relaxed);
+	}
+
+	return hash;
+}
+
+std::shared_ptr<StringValue> concatenate(std::shared_ptr<StringValue> left, std::shared_ptr<StringValue> right)
+{
+	if (right->size() == 0)
+		return left;
+
+	if (left->size() == 0)
+		return right;
+
+	std::size_t length = concatenatedLength(*left, *right);
+
+	if (length > ROPE_THRESHOLD)
+		return std::make_shared<StringValue>(std::move(left), std::move(right));
+
+	std::string text;
+	text.reserve(length);
+	text += left->view();
+	text += right->view();
+
+	return std::make_shared<StringValue>(text);
+}
+
+std::shared_ptr<StringValue> internString(std::string_view text)
+{
+	InternTable& table = internTable();
+	std::lock_guard<std::mutex> lock(table.mutex);
+
+	auto found = table.strings.find(text);
+
+	if (found != table.strings.end()) {
+		if (auto value = found->second.handle.lock())
+			return value;
+
+		// Its last holder is gone and its destructor is waiting for the lock.
+		table.strings.erase(found);
+	}
+
+	auto value = std::make_shared<StringValue>(text);
+
+	value->hash();
+
+	{
+		MemoryScope untracked(nullptr);
+		table.strings.emplace(value->view(), InternEntry { value.get(), value });
+	}
+
+	// Only once it is in the table; a string dropped before that must not look for its entry.
+	value->interned = true;
+
+	return value;
+}
+
+std::shared_ptr<StringValue> findInternedString(std::string_view text)
+{
+	InternTable& table = internTable();
+	std::lock_guard<std::mutex> lock(table.mutex);
+
+	auto found = table.strings.find(text);
+
+	return found != table.strings.end() ? found->second.handle.lock() : nullptr;
+}
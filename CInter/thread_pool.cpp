@@ -0,0 +1,137 @@
+#include "thread_pool.h"
+#include "memory.h"
+
+#include <algorithm>
+
+namespace {
+
+thread_local const WorkStealingPool* currentPool = nullptr;
+thread_local std::size_t currentQueue = 0;
+
+}
+
+WorkStealingPool::WorkStealingPool(std::size_t workerCount)
+{
+	workerCount = std::max<std::size_t>(workerCount, 1);
+
+	for (std::size_t i = 0; i < workerCount; ++i) {
+		this->queues.push_back(std::make_unique<Queue>());
+	}
+
+	for (std::size_t i = 0; i < workerCount; ++i) {
+		this->workers.emplace_back([this, i] { this->work(i); });
+	}
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->stopping = true;
+	}
+
+	this->available.notify_all();
+
+	for (auto& worker : this->workers) {
+		worker.join();
+	}
+}
+
+// Intentionally leaked: joining workers during static destruction could wait on work that never ends.
+WorkStealingPool& WorkStealingPool::shared()
+{
+	static WorkStealingPool* instance = [] {
+		MemoryScope untracked(nullptr);
+		return new WorkStealingPool();
+	}();
+
+	return *instance;
+}
+
+bool WorkStealingPool::take(std::size_t preferred, bool ownQueue, std::function<void()>& task)
+{
+	if (ownQueue) {
+		Queue& own = *this->queues[preferred];
+		std::lock_guard<std::mutex> lock(own.mutex);
+
+		if (!own.tasks.empty()) {
+			task = std::move(own.tasks.back());
+			own.tasks.pop_back();
+			this->queued.fetch_sub(1);
+
+			return true;
+		}
+	}
+
+	for (std::size_t i = ownQueue ? 1 : 0; i < this->queues.size(); ++i) {
+		Queue& victim = *this->queues[(preferred + i) % this->queues.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+
+		if (!victim.tasks.empty()) {
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			this->queued.fetch_sub(1);
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void WorkStealingPool::work(std::size_t index)
+{
+	currentPool = this;
+	currentQueue = index;
+
+	for (;;) {
+		std::function<void()> task;
+
+		if (this->take(index, true, task)) {
+			task();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(this->mutex);
+
+		this->available.wait(lock, [this] { return this->stopping || this->queued.load() > 0; });
+
+		if (this->stopping && this->queued.load() == 0)
+			return;
+	}
+}
+
+// Tasks must not throw; they run on worker threads with nobody to report to.
+void WorkStealingPool::submit(std::function<void()> task)
+{
+	bool local = currentPool == this;
+	std::size_t index = local ? currentQueue : this->nextQueue.fetch_add(1) % this->queues.size();
+
+	// Counted before it is visible, so `queued` never drops below the number of tasks in the deques.
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->queued.fetch_add(1);
+	}
+
+	{
+		Queue& queue = *this->queues[index];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+
+		queue.tasks.push_back(std::move(task));
+	}
+
+	this->available.notify_one();
+}
+
+bool WorkStealingPool::runPending()
+{
+	bool local = currentPool == this;
+	std::function<void()> task;
+
+	if (!this->take(local ? currentQueue : 0, local, task))
+		return false;
+
+	task();
+
+	return true;
+}
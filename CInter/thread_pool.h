@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads, each with its own task deque. A worker runs its own newest task
+// first and, once its deque is empty, steals the oldest task of another worker. Tasks submitted
+// from a worker go to that worker's deque, so a task's follow-up work tends to stay on its thread.
+class WorkStealingPool {
+	private:
+		struct Queue {
+			std::mutex mutex;
+			std::deque<std::function<void()>> tasks;
+		};
+
+		std::vector<std::unique_ptr<Queue>> queues;
+		std::vector<std::thread> workers;
+		std::mutex mutex;
+		std::condition_variable available;
+		std::atomic<std::size_t> queued { 0 };
+		std::atomic<std::size_t> nextQueue { 0 };
+		bool stopping = false;
+
+		void work(std::size_t index);
+		bool take(std::size_t preferred, bool ownQueue, std::function<void()>& task);
+
+	public:
+		explicit WorkStealingPool(std::size_t workerCount = std::thread::hardware_concurrency());
+		~WorkStealingPool();
+
+		WorkStealingPool(const WorkStealingPool&) = delete;
+		WorkStealingPool& operator = (const WorkStealingPool&) = delete;
+
+		// Process-wide pool sized to the machine; it is never destroyed.
+		static WorkStealingPool& shared();
+
+		std::size_t size() const { return this->workers.size(); }
+
+		void submit(std::function<void()> task);
+
+		// Steals one queued task and runs it on the calling thread. Returns false if none was queued.
+		bool runPending();
+};
@@ -0,0 +1,634 @@
+#include "value_numbering.h"
+#include "dependencies.h"
+#include "environment.h"
+#include "values.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Temporaries are numbered process-wide, so programs evaluated in one environment never collide.
+std::atomic<std::size_t> nextTemporary { 0 };
+
+// The place in the tree that owns an expression; binary operands are shared, everything else unique.
+struct Slot {
+	std::unique_ptr<Expression>* unique = nullptr;
+	std::shared_ptr<Expression>* shared = nullptr;
+
+	explicit operator bool() const { return this->unique || this->shared; }
+
+	void replace(std::unique_ptr<Expression> node) const {
+		if (this->unique) {
+			releaseNode(std::move(*this->unique));
+			*this->unique = std::move(node);
+		}
+		else {
+			releaseSharedNode(std::move(*this->shared));
+			*this->shared = std::move(node);
+		}
+	}
+};
+
+struct NodeInfo {
+	bool pure = false;
+	std::size_t hash = 0;
+	std::size_t size = 1;
+	std::set<std::string> reads;
+};
+
+struct Occurrence {
+	Slot slot;
+	const Expression* node;
+	std::size_t statement;
+	bool dead = false;
+};
+
+struct ValueClass {
+	const Expression* representative;
+	std::size_t hash;
+	std::size_t size;
+	std::set<std::string> reads;
+	std::vector<std::size_t> occurrences;
+	std::string temporary;
+};
+
+std::size_t combine(std::size_t seed, std::size_t value)
+{
+	return seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+}
+
+const std::string& propertyName(const MemberExpression& member)
+{
+	return static_cast<const _Identifier&>(*member.property).symbol;
+}
+
+bool sameStructure(const Expression& first, const Expression& second)
+{
+	std::vector<std::pair<const Expression*, const Expression*>> pending { { &first, &second } };
+
+	while (!pending.empty()) {
+		auto [lhs, rhs] = pending.back();
+		pending.pop_back();
+
+		if (lhs->kind != rhs->kind)
+			return false;
+
+		switch (lhs->kind) {
+			case NodeType::NumericLiteral: {
+				double left = static_cast<const NumericLiteral&>(*lhs).value;
+				double right = static_cast<const NumericLiteral&>(*rhs).value;
+
+				if (std::memcmp(&left, &right, sizeof(double)) != 0)
+					return false;
+
+				break;
+			}
+
+			case NodeType::StringLiteral:
+				if (static_cast<const StringLiteral&>(*lhs).value->view() != static_cast<const StringLiteral&>(*rhs).value->view())
+					return false;
+
+				break;
+
+			case NodeType::Identifier:
+				if (static_cast<const _Identifier&>(*lhs).symbol != static_cast<const _Identifier&>(*rhs).symbol)
+					return false;
+
+				break;
+
+			case NodeType::BinaryExpression: {
+				auto& left = static_cast<const BinaryExpression&>(*lhs);
+				auto& right = static_cast<const BinaryExpression&>(*rhs);
+
+				if (left._operator != right._operator)
+					return false;
+
+				pending.push_back({ left.left.get(), right.left.get() });
+				pending.push_back({ left.right.get(), right.right.get() });
+				break;
+			}
+
+			case NodeType::MemberExpression: {
+				auto& left = static_cast<const MemberExpression&>(*lhs);
+				auto& right = static_cast<const MemberExpression&>(*rhs);
+
+				if (left.computed != right.computed)
+					return false;
+
+				if (left.computed)
+					pending.push_back({ left.property.get(), right.property.get() });
+
+				else if (propertyName(left) != propertyName(right))
+					return false;
+
+				pending.push_back({ left.object.get(), right.object.get() });
+				break;
+			}
+
+			default:
+				return false;
+		}
+	}
+
+	return true;
+}
+
+std::unique_ptr<Expression> cloneExpression(const Expression& source)
+{
+	std::unique_ptr<Expression> root;
+	std::vector<std::pair<const Expression*, Slot>> pending { { &source, Slot { &root, nullptr } } };
+
+	while (!pending.empty()) {
+		auto [node, target] = pending.back();
+		pending.pop_back();
+
+		std::unique_ptr<Expression> copy;
+
+		switch (node->kind) {
+			case NodeType::NumericLiteral: {
+				auto literal = std::make_unique<NumericLiteral>();
+				literal->value = static_cast<const NumericLiteral&>(*node).value;
+				copy = std::move(literal);
+				break;
+			}
+
+			case NodeType::StringLiteral: {
+				auto literal = std::make_unique<StringLiteral>();
+				literal->value = static_cast<const StringLiteral&>(*node).value;
+				copy = std::move(literal);
+				break;
+			}
+
+			case NodeType::Identifier:
+				copy = std::make_unique<_Identifier>(static_cast<const _Identifier&>(*node).symbol);
+				break;
+
+			case NodeType::BinaryExpression: {
+				auto& original = static_cast<const BinaryExpression&>(*node);
+				auto binary = std::make_unique<BinaryExpression>();
+
+				binary->_operator = original._operator;
+				pending.push_back({ original.left.get(), Slot { nullptr, &binary->left } });
+				pending.push_back({ original.right.get(), Slot { nullptr, &binary->right } });
+				copy = std::move(binary);
+				break;
+			}
+
+			case NodeType::MemberExpression: {
+				auto& original = static_cast<const MemberExpression&>(*node);
+				auto member = std::make_unique<MemberExpression>(original.computed);
+
+				member->internedKey = original.internedKey;
+				pending.push_back({ original.object.get(), Slot { &member->object, nullptr } });
+				pending.push_back({ original.property.get(), Slot { &member->property, nullptr } });
+				copy = std::move(member);
+				break;
+			}
+
+			default:
+				throw std::logic_error("Only pure expressions can be shared.");
+		}
+
+		if (target.unique)
+			*target.unique = std::move(copy);
+		else
+			*target.shared = std::move(copy);
+	}
+
+	return root;
+}
+
+std::size_t countNodes(const Program& program)
+{
+	std::size_t count = 0;
+	std::vector<const Statement*> pending;
+
+	for (const auto& statement : program.body) {
+		pending.push_back(statement.get());
+	}
+
+	auto visit = [&pending](const Statement* node) {
+		if (node)
+			pending.push_back(node);
+	};
+
+	while (!pending.empty()) {
+		const Statement& node = *pending.back();
+		pending.pop_back();
+		++count;
+
+		switch (node.kind) {
+			case NodeType::VariableDeclaration:
+				visit(static_cast<const VariableDeclaration&>(node).value.get());
+				break;
+
+			case NodeType::BinaryExpression:
+				visit(static_cast<const BinaryExpression&>(node).left.get());
+				visit(static_cast<const BinaryExpression&>(node).right.get());
+				break;
+
+			case NodeType::AssignmentExpression:
+				visit(static_cast<const AssignmentExpression&>(node).assignee.get());
+				visit(static_cast<const AssignmentExpression&>(node).value.get());
+				break;
+
+			case NodeType::ObjectLiteral:
+				for (const auto& property : static_cast<const ObjectLiteral&>(node).properties) {
+					visit(property.get());
+				}
+
+				break;
+
+			case NodeType::Property:
+				visit(static_cast<const Property&>(node).value.get());
+				break;
+
+			case NodeType::MemberExpression:
+				visit(static_cast<const MemberExpression&>(node).object.get());
+				visit(static_cast<const MemberExpression&>(node).property.get());
+				break;
+
+			case NodeType::CallExpression:
+				visit(static_cast<const CallExpression&>(node).caller.get());
+
+				for (const auto& argument : static_cast<const CallExpression&>(node).args) {
+					visit(argument.get());
+				}
+
+				break;
+
+			default:
+				break;
+		}
+	}
+
+	return count;
+}
+
+class ValueNumbering {
+	private:
+		Program& program;
+		std::vector<Occurrence> occurrences;
+		std::vector<ValueClass> classes;
+		std::unordered_multimap<std::size_t, std::size_t> liveClasses;
+		std::unordered_map<const Expression*, std::size_t> occurrenceOf;
+
+		void record(const Slot& slot, const Expression& node, NodeInfo& info, std::size_t statement) {
+			std::size_t found = this->classes.size();
+			auto range = this->liveClasses.equal_range(info.hash);
+
+			for (auto it = range.first; it != range.second; ++it) {
+				if (sameStructure(*this->classes[it->second].representative, node)) {
+					found = it->second;
+					break;
+				}
+			}
+
+			if (found == this->classes.size()) {
+				this->classes.push_back({ &node, info.hash, info.size, info.reads, {}, {} });
+				this->liveClasses.emplace(info.hash, found);
+			}
+
+			this->occurrenceOf[&node] = this->occurrences.size();
+			this->classes[found].occurrences.push_back(this->occurrences.size());
+			this->occurrences.push_back({ slot, &node, statement });
+		}
+
+		void kill(const std::function<bool(const ValueClass&)>& invalid) {
+			for (auto it = this->liveClasses.begin(); it != this->liveClasses.end();) {
+				if (invalid(this->classes[it->second]))
+					it = this->liveClasses.erase(it);
+				else
+					++it;
+			}
+		}
+
+		// Post-order walk of one statement computing, for every pure subtree, its structural hash, size
+		// and the variables it reads. Assignment targets are skipped: they are places, not values.
+		void number(Statement& statement, std::size_t index, const std::set<std::string>& killed) {
+			struct Frame {
+				Statement* node;
+				Slot slot;
+				bool expanded;
+			};
+
+			std::unordered_map<const Statement*, NodeInfo> infos;
+			std::vector<Frame> pending { { &statement, Slot(), false } };
+
+			auto child = [&pending](Statement* node, Slot slot) {
+				if (node)
+					pending.push_back({ node, slot, false });
+			};
+
+			while (!pending.empty()) {
+				Frame& frame = pending.back();
+				Statement* node = frame.node;
+
+				if (!frame.expanded) {
+					frame.expanded = true;
+
+					switch (node->kind) {
+						case NodeType::VariableDeclaration: {
+							auto& declaration = static_cast<VariableDeclaration&>(*node);
+							child(declaration.value.get(), Slot { &declaration.value, nullptr });
+							break;
+						}
+
+						case NodeType::AssignmentExpression: {
+							auto& assignment = static_cast<AssignmentExpression&>(*node);
+							child(assignment.value.get(), Slot { &assignment.value, nullptr });
+							break;
+						}
+
+						case NodeType::BinaryExpression: {
+							auto& binary = static_cast<BinaryExpression&>(*node);
+							child(binary.left.get(), Slot { nullptr, &binary.left });
+							child(binary.right.get(), Slot { nullptr, &binary.right });
+							break;
+						}
+
+						case NodeType::MemberExpression: {
+							auto& member = static_cast<MemberExpression&>(*node);
+							child(member.object.get(), Slot { &member.object, nullptr });
+
+							if (member.computed)
+								child(member.property.get(), Slot { &member.property, nullptr });
+
+							break;
+						}
+
+						case NodeType::ObjectLiteral:
+							for (auto& property : static_cast<ObjectLiteral&>(*node).properties) {
+								child(property.get(), Slot());
+							}
+
+							break;
+
+						case NodeType::Property: {
+							auto& property = static_cast<Property&>(*node);
+							child(property.value.get(), Slot { &property.value, nullptr });
+							break;
+						}
+
+						default:
+							break;
+					}
+
+					continue;
+				}
+
+				Slot slot = frame.slot;
+				pending.pop_back();
+
+				NodeInfo info;
+				info.hash = std::hash<int>{}(static_cast<int>(node->kind));
+
+				switch (node->kind) {
+					case NodeType::NumericLiteral: {
+						double value = static_cast<const NumericLiteral&>(*node).value;
+						std::uint64_t bits;
+
+						std::memcpy(&bits, &value, sizeof(bits));
+						info.pure = true;
+						info.hash = combine(info.hash, std::hash<std::uint64_t>{}(bits));
+						break;
+					}
+
+					case NodeType::StringLiteral:
+						info.pure = true;
+						info.hash = combine(info.hash, static_cast<const StringLiteral&>(*node).value->hash());
+						break;
+
+					case NodeType::Identifier: {
+						const std::string& symbol = static_cast<const _Identifier&>(*node).symbol;
+
+						info.pure = true;
+						info.hash = combine(info.hash, std::hash<std::string>{}(symbol));
+						info.reads.insert(symbol);
+						break;
+					}
+
+					case NodeType::BinaryExpression: {
+						auto& binary = static_cast<const BinaryExpression&>(*node);
+						NodeInfo& left = infos[binary.left.get()];
+						NodeInfo& right = infos[binary.right.get()];
+
+						info.pure = left.pure && right.pure;
+						info.hash = combine(combine(combine(info.hash, std::hash<std::string>{}(binary._operator)), left.hash), right.hash);
+						info.size += left.size + right.size;
+						info.reads = std::move(left.reads);
+						info.reads.insert(right.reads.begin(), right.reads.end());
+						break;
+					}
+
+					case NodeType::MemberExpression: {
+						auto& member = static_cast<const MemberExpression&>(*node);
+						NodeInfo& object = infos[member.object.get()];
+
+						info.pure = object.pure;
+						info.hash = combine(info.hash, object.hash);
+						info.size += object.size + 1;
+						info.reads = std::move(object.reads);
+
+						if (member.computed) {
+							NodeInfo& property = infos[member.property.get()];
+
+							info.pure = info.pure && property.pure;
+							info.hash = combine(combine(info.hash, 1), property.hash);
+							info.size += property.size - 1;
+							info.reads.insert(property.reads.begin(), property.reads.end());
+						}
+						else {
+							info.hash = combine(info.hash, std::hash<std::string>{}(propertyName(member)));
+						}
+
+						break;
+					}
+
+					default:
+						break;
+				}
+
+				bool shareable = node->kind == NodeType::BinaryExpression || node->kind == NodeType::MemberExpression;
+				bool stable = std::none_of(info.reads.begin(), info.reads.end(), [&killed](const std::string& name) {
+					return killed.count(name) > 0;
+				});
+
+				if (slot && info.pure && shareable && stable)
+					this->record(slot, static_cast<const Expression&>(*node), info, index);
+
+				infos[node] = std::move(info);
+			}
+		}
+
+		void markDescendantsDead(const Expression& root) {
+			std::vector<const Statement*> pending { &root };
+
+			while (!pending.empty()) {
+				const Statement* node = pending.back();
+				pending.pop_back();
+
+				if (node != &root) {
+					auto found = this->occurrenceOf.find(static_cast<const Expression*>(node));
+
+					if (found != this->occurrenceOf.end())
+						this->occurrences[found->second].dead = true;
+				}
+
+				if (node->kind == NodeType::BinaryExpression) {
+					pending.push_back(static_cast<const BinaryExpression*>(node)->left.get());
+					pending.push_back(static_cast<const BinaryExpression*>(node)->right.get());
+				}
+				else if (node->kind == NodeType::MemberExpression) {
+					pending.push_back(static_cast<const MemberExpression*>(node)->object.get());
+					pending.push_back(static_cast<const MemberExpression*>(node)->property.get());
+				}
+			}
+		}
+
+		std::vector<std::size_t> liveOccurrences(const ValueClass& value) const {
+			std::vector<std::size_t> live;
+
+			for (std::size_t occurrence : value.occurrences) {
+				if (!this->occurrences[occurrence].dead)
+					live.push_back(occurrence);
+			}
+
+			return live;
+		}
+
+	public:
+		explicit ValueNumbering(Program& program) : program(program) {}
+
+		ValueNumberingReport run() {
+			ValueNumberingReport report;
+			std::size_t before = countNodes(this->program);
+
+			for (std::size_t i = 0; i < this->program.body.size(); ++i) {
+				Statement& statement = *this->program.body[i];
+				StatementDependencies dependencies = analyzeStatement(statement);
+
+				// A call may do anything, including assigning variables, so nothing survives it.
+				if (!dependencies.pure) {
+					this->kill([](const ValueClass&) { return true; });
+					continue;
+				}
+
+				std::set<std::string> killed = dependencies.writes;
+
+				if (statement.kind == NodeType::VariableDeclaration)
+					killed.insert(static_cast<const VariableDeclaration&>(statement).identifier);
+
+				else if (statement.kind == NodeType::ImportDeclaration)
+					killed.insert(static_cast<const ImportDeclaration&>(statement).binding);
+
+				this->number(statement, i, killed);
+
+				this->kill([&killed](const ValueClass& value) {
+					return std::any_of(value.reads.begin(), value.reads.end(), [&killed](const std::string& name) {
+						return killed.count(name) > 0;
+					});
+				});
+			}
+
+			// Outermost first: sharing an expression makes everything inside its repeats disappear.
+			std::vector<std::size_t> order(this->classes.size());
+
+			for (std::size_t i = 0; i < order.size(); ++i) {
+				order[i] = i;
+			}
+
+			std::stable_sort(order.begin(), order.end(), [this](std::size_t lhs, std::size_t rhs) {
+				return this->classes[lhs].size > this->classes[rhs].size;
+			});
+
+			std::vector<std::size_t> selected;
+
+			for (std::size_t index : order) {
+				ValueClass& value = this->classes[index];
+				auto live = this->liveOccurrences(value);
+
+				// k repeats of an s-node tree cost k * s evaluations, shared they cost s + k + 1.
+				if (live.size() < 2 || (live.size() - 1) * (value.size - 1) <= 2)
+					continue;
+
+				selected.push_back(index);
+
+				for (std::size_t i = 1; i < live.size(); ++i) {
+					this->markDescendantsDead(*this->occurrences[live[i]].node);
+				}
+			}
+
+			// Innermost first, so an outer temporary is built from a first occurrence that already
+			// refers to the inner ones. Temporaries are declared in that order too.
+			std::map<std::size_t, std::vector<std::unique_ptr<Statement>>> declarations;
+
+			for (auto it = selected.rbegin(); it != selected.rend(); ++it) {
+				ValueClass& value = this->classes[*it];
+				auto live = this->liveOccurrences(value);
+				const Occurrence& first = this->occurrences[live.front()];
+				auto declaration = std::make_unique<VariableDeclaration>();
+
+				value.temporary = "$cse" + std::to_string(nextTemporary.fetch_add(1));
+				declaration->constant = true;
+				declaration->identifier = value.temporary;
+				declaration->value = cloneExpression(*first.node);
+				declarations[first.statement].push_back(std::move(declaration));
+
+				for (std::size_t occurrence : live) {
+					this->occurrences[occurrence].slot.replace(std::make_unique<_Identifier>(value.temporary));
+				}
+
+				++report.temporaries;
+				report.temporaryNames.push_back(value.temporary);
+			}
+
+			if (declarations.empty())
+				return report;
+
+			std::vector<std::unique_ptr<Statement>> body;
+
+			for (std::size_t i = 0; i < this->program.body.size(); ++i) {
+				auto hoisted = declarations.find(i);
+
+				if (hoisted != declarations.end()) {
+					for (auto& declaration : hoisted->second) {
+						body.push_back(std::move(declaration));
+					}
+				}
+
+				body.push_back(std::move(this->program.body[i]));
+			}
+
+			this->program.body = std::move(body);
+
+			std::size_t after = countNodes(this->program);
+			report.eliminatedNodes = before > after ? before - after : 0;
+
+			return report;
+		}
+};
+
+}
+
+ValueNumberingReport eliminateCommonSubexpressions(Program& program)
+{
+	return ValueNumbering(program).run();
+}
+
+void releaseTemporaries(const ValueNumberingReport& report, Environment& env)
+{
+	for (const auto& name : report.temporaryNames) {
+		env.undeclareVariable(name);
+	}
+}
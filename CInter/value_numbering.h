@@ -0,0 +1,32 @@
+#pragma once
+
+#include "ast.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class Environment;
+
+struct ValueNumberingReport {
+	// AST nodes the program no longer evaluates, net of the declarations that were added.
+	std::size_t eliminatedNodes = 0;
+	std::size_t temporaries = 0;
+
+	// Names of the hidden constants, in declaration order.
+	std::vector<std::string> temporaryNames;
+};
+
+// Global value numbering over the top-level statements of `program`. Structurally identical pure
+// expressions (literals, identifiers, binary and member expressions) that recur while none of the
+// variables they read is assigned or redeclared, and with no call in between, are computed once
+// into a hidden constant declared just before the first statement that needs it, named `$cse0`,
+// `$cse1`, ... (source code cannot spell these names). Repeats are only shared when that saves
+// evaluations. The temporary is evaluated ahead of the rest of its statement, so a statement that
+// fails anyway may report a different one of its errors.
+ValueNumberingReport eliminateCommonSubexpressions(Program& program);
+
+// Removes the temporaries of `report` from the scope the rewritten program ran in. Call it once
+// the program has finished or failed, so the temporaries never reach snapshots, module exports or
+// later code sharing the environment.
+void releaseTemporaries(const ValueNumberingReport& report, Environment& env);
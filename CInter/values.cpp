@@ -1,5 +1,8 @@
 #include "values.h"
 
+#include <charconv>
+#include <cmath>
+
 std::unique_ptr<NullValue> MAKE_NULL()
 {
     return std::make_unique<NullValue>();
@@ -15,7 +18,132 @@ std::unique_ptr<BooleanValue> MAKE_BOOL(bool b)
     return std::make_unique<BooleanValue>(b);
 }
 
-std::unique_ptr<NativeFunctionValue> MAKE_NATIVE_FUNCTION(FunctionCall call)
+std::unique_ptr<NativeFunctionValue> MAKE_NATIVE_FUNCTION(FunctionCall call, bool pure)
+{
+    return std::make_unique<NativeFunctionValue>(call, pure);
+}
+
+std::unique_ptr<ObjectValue> MAKE_OBJECT(PropertyMap properties)
+{
+    return std::make_unique<ObjectValue>(std::move(properties));
+}
+
+std::unique_ptr<StringValue> MAKE_STRING(std::string_view text)
+{
+    return std::make_unique<StringValue>(text);
+}
+
+std::string formatNumber(double number)
+{
+    if (number == std::floor(number) && std::fabs(number) < 1e15)
+        return std::to_string(static_cast<long long>(number));
+
+    char text[32];
+    auto result = std::to_chars(text, text + sizeof(text), number);
+
+    return std::string(text, result.ptr);
+}
+
+namespace {
+
+// Everything but non-empty objects, which formatValue expands itself.
+std::string formatLeaf(const RuntimeValue& value)
+{
+    switch (value.getType()) {
+        case ValueType::Null:
+            return "null";
+
+        case ValueType::Boolean:
+            return static_cast<const BooleanValue&>(value).value ? "true" : "false";
+
+        case ValueType::Number:
+            return formatNumber(static_cast<const NumberValue&>(value).value);
+
+        case ValueType::Object:
+            return "{}";
+
+        case ValueType::String: {
+            std::string text = "\"";
+
+            for (char ch : static_cast<const StringValue&>(value).view()) {
+                switch (ch) {
+                    case '"':
+                    case '\\':
+                        text += '\\';
+                        text += ch;
+                        break;
+
+                    case '\n':
+                        text += "\\n";
+                        break;
+
+                    case '\t':
+                        text += "\\t";
+                        break;
+
+                    default:
+                        text += ch;
+                }
+            }
+
+            return text + "\"";
+        }
+
+        default:
+            return "<native function>";
+    }
+}
+
+}
+
+// Objects may nest as deep as a script builds them, so open objects are kept on an explicit stack.
+std::string formatValue(const RuntimeValue& value)
+{
+    struct OpenObject {
+        std::vector<std::pair<std::string, PropertyMap::Value>> entries;
+        std::size_t next = 0;
+    };
+
+    std::string text;
+    std::vector<OpenObject> open;
+
+    auto append = [&](const RuntimeValue& item) {
+        if (item.getType() == ValueType::Object && !static_cast<const ObjectValue&>(item).properties.empty()) {
+            text += "{ ";
+            open.push_back({ static_cast<const ObjectValue&>(item).properties.entries() });
+        }
+        else {
+            text += formatLeaf(item);
+        }
+    };
+
+    append(value);
+
+    while (!open.empty()) {
+        OpenObject& object = open.back();
+
+        if (object.next == object.entries.size()) {
+            text += " }";
+            open.pop_back();
+            continue;
+        }
+
+        if (object.next > 0)
+            text += ", ";
+
+        auto entry = object.entries[object.next++];
+
+        text += entry.first + ": ";
+        append(*entry.second);
+    }
+
+    return text;
+}
+
+std::shared_ptr<StringValue> toStringValue(const std::shared_ptr<RuntimeValue>& value)
 {
-    return std::make_unique<NativeFunctionValue>(call);
+    if (value->getType() == ValueType::String)
+        return std::static_pointer_cast<StringValue>(value);
+
+    return MAKE_STRING(formatValue(*value));
 }
@@ -1,18 +1,25 @@
 #pragma once
 
+#include <atomic>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <functional>
-#include "environment.h"
+#include "properties.h"
+
+class Environment;
 
 enum class ValueType {
 	Null,
 	Number,
 	Boolean,
 	Object,
-	nativeFunction
+	nativeFunction,
+	asyncNativeFunction,
+	String
 };
 
 struct RuntimeValue {
@@ -53,10 +60,75 @@ struct ObjectValue : public RuntimeValue {
 		return ValueType::Object;
 	}
 
-	std::map<std::string, std::unique_ptr<RuntimeValue>> properties;
+	PropertyMap properties;
+
+	ObjectValue(PropertyMap props = {}) : properties(std::move(props)) {}
+
+	// Objects are never mutated in place: a derived object shares every unchanged property.
+	std::shared_ptr<ObjectValue> with(const std::string& key, std::shared_ptr<RuntimeValue> value) const {
+		return std::make_shared<ObjectValue>(properties.set(key, std::move(value)));
+	}
+
+	std::shared_ptr<ObjectValue> with(std::string_view key, std::size_t hash, std::shared_ptr<RuntimeValue> value) const {
+		return std::make_shared<ObjectValue>(properties.set(key, hash, std::move(value)));
+	}
 };
 
-using FunctionCall = std::function<RuntimeValue>(const std::vector<RuntimeValue>&, Environment&);
+// Strings are immutable. Short ones live inside the value itself, longer ones in one heap buffer.
+// Concatenating long strings builds a rope node instead of copying, and the rope is flattened the
+// first time its characters are read, so building a string piece by piece stays linear.
+struct StringValue : public RuntimeValue {
+	static constexpr std::size_t INLINE_CAPACITY = 22;
+
+	// Longer results throw instead of being built, so a doubling loop fails long before the length
+	// could wrap around.
+	static constexpr std::size_t MAX_LENGTH = std::size_t(1) << 30;
+
+	ValueType getType() const override {
+		return ValueType::String;
+	}
+
+	explicit StringValue(std::string_view text);
+	StringValue(std::shared_ptr<StringValue> left, std::shared_ptr<StringValue> right);
+	~StringValue() override;
+
+	StringValue(const StringValue&) = delete;
+	StringValue& operator = (const StringValue&) = delete;
+
+	std::size_t size() const { return length; }
+	std::string_view view() const;
+
+	// Same hash as PropertyMap::hashKey, computed once per value.
+	std::size_t hash() const;
+
+	private:
+		friend std::shared_ptr<StringValue> internString(std::string_view text);
+
+		std::size_t length;
+		bool interned = false;
+		mutable std::atomic<std::size_t> cachedHash { 0 };
+		mutable std::atomic<const char*> flat { nullptr };
+		mutable std::unique_ptr<char[]> buffer;
+		mutable std::once_flag flattened;
+		std::shared_ptr<StringValue> left;
+		std::shared_ptr<StringValue> right;
+		char small[INLINE_CAPACITY];
+
+		void flatten() const;
+};
+
+// Returns `left + right`, sharing both operands when the result is too long to copy cheaply.
+std::shared_ptr<StringValue> concatenate(std::shared_ptr<StringValue> left, std::shared_ptr<StringValue> right);
+
+// Process-wide table of the interned strings that are still alive; equal text always yields the
+// same value while any holder of it remains. The values are charged to the caller's memory context
+// and leave the table when their last holder releases them.
+std::shared_ptr<StringValue> internString(std::string_view text);
+
+// The interned value for `text`, or nullptr if it was never interned; never adds to the table.
+std::shared_ptr<StringValue> findInternedString(std::string_view text);
+
+using FunctionCall = std::function<std::shared_ptr<RuntimeValue>(const std::vector<std::shared_ptr<RuntimeValue>>&, Environment&)>;
 
 struct NativeFunctionValue : public RuntimeValue {
 	ValueType getType() const override {
@@ -64,9 +136,27 @@ struct NativeFunctionValue : public RuntimeValue {
 	}
 
 	FunctionCall call;
+
+	// A pure native only reads its arguments: it neither touches the environment nor keeps state, so
+	// calls to it need not be ordered against other statements.
+	bool pure;
+
+	NativeFunctionValue(FunctionCall fn, bool pure = false) : call(std::move(fn)), pure(pure) {}
 };
 
 std::unique_ptr<NullValue> MAKE_NULL();
 std::unique_ptr<NumberValue> MAKE_NUMBER(double n = 0.0);
 std::unique_ptr<BooleanValue> MAKE_BOOL(bool b = true);
-std::unique_ptr<NativeFunctionValue> MAKE_NATIVE_FUNCTION(FunctionCall call);
\ No newline at end of file
+std::unique_ptr<NativeFunctionValue> MAKE_NATIVE_FUNCTION(FunctionCall call, bool pure = false);
+std::unique_ptr<ObjectValue> MAKE_OBJECT(PropertyMap properties = {});
+std::unique_ptr<StringValue> MAKE_STRING(std::string_view text);
+
+// Integers print without a fraction; anything else in the shortest form that reads back as the same
+// double, so distinct numbers never format alike. Also used for numeric property keys.
+std::string formatNumber(double number);
+
+// Human-readable rendering used by the REPL; objects list their properties in key order.
+std::string formatValue(const RuntimeValue& value);
+
+// The value itself for strings, otherwise its formatValue text; used by string concatenation.
+std::shared_ptr<StringValue> toStringValue(const std::shared_ptr<RuntimeValue>& value);